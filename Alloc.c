@@ -0,0 +1,58 @@
+#include "Alloc.h"
+
+/// \brief Placed before every counted block, keeps the block maximally aligned.
+typedef union AllocHeader {
+	struct {
+		size_t size;
+		AllocTag tag;
+	} info;
+	max_align_t align;
+} AllocHeader;
+
+/// \brief Guarded by a spinlock, the trace rings are allocated on other threads too.
+typedef struct AllocCounters {
+	SDL_SpinLock lock;
+	AllocStats stats;
+} AllocCounters;
+
+static AllocCounters _Counters[N_ALLOC_TAGS] = { 0 };
+
+static void Count(AllocTag tag, Sint64 bytes, Sint64 blocks) {
+	AllocCounters* counters = &_Counters[tag];
+	SDL_AtomicLock(&counters->lock);
+	counters->stats.bytes += bytes;
+	counters->stats.blocks += blocks;
+	if (blocks > 0) counters->stats.total_blocks += blocks;
+	SDL_AtomicUnlock(&counters->lock);
+}
+
+void* Alloc_Malloc(AllocTag tag, size_t size) {
+	AllocHeader* header = malloc(sizeof(AllocHeader) + size);
+	if (header == NULL) return NULL;
+
+	header->info.size = size;
+	header->info.tag = tag;
+	Count(tag, (Sint64)size, 1);
+
+	return header + 1;
+}
+
+void Alloc_Free(void* ptr) {
+	if (ptr == NULL) return;
+	AllocHeader* header = (AllocHeader*)ptr - 1;
+
+	Count(header->info.tag, -(Sint64)header->info.size, -1);
+	free(header);
+}
+
+void Alloc_Track(AllocTag tag, Sint64 bytes) {
+	Count(tag, bytes, bytes > 0 ? 1 : -1);
+}
+
+AllocStats Alloc_GetStats(AllocTag tag) {
+	AllocCounters* counters = &_Counters[tag];
+	SDL_AtomicLock(&counters->lock);
+	AllocStats stats = counters->stats;
+	SDL_AtomicUnlock(&counters->lock);
+	return stats;
+}
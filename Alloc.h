@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <SDL.h>
+
+/// \brief The allocation layer, include this instead of stdlib's malloc in every translation unit.
+///
+/// Build flags:
+/// - none: RG_MALLOC and RG_FREE are plain malloc and free, zero overhead.
+/// - RGUI_ALLOC_STATS: every block carries a small header, the bytes and the blocks
+///   are counted per subsystem and can be read with Alloc_GetStats at runtime.
+/// - RGUI_DEBUGMALLOC: every allocation goes through debugmalloc,
+///   which dumps the leaks into debugmalloc.log on exit. It isn't thread-safe,
+///   so it's only for debugging without posting commands from other threads.
+#ifdef RGUI_DEBUGMALLOC
+#include <debugmalloc.h>
+#endif
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+/// \brief The subsystems the allocations are counted for.
+typedef enum AllocTag {
+	/// \brief UIElems, their data and the windows.
+	AllocTree = 0,
+	AllocCallbacks = 1,
+	/// \brief Estimated from the size of the loaded textures.
+	AllocTextures = 2,
+	AllocParser = 3,
+	AllocOther = 4
+} AllocTag;
+/// \brief The number of AllocTags
+#define N_ALLOC_TAGS 5
+
+/// \brief The counters of one subsystem.
+typedef struct AllocStats {
+	/// \brief The bytes currently allocated.
+	Sint64 bytes;
+	/// \brief The blocks currently allocated.
+	Sint64 blocks;
+	/// \brief Every allocation since the start.
+	Sint64 total_blocks;
+} AllocStats;
+
+#ifdef RGUI_ALLOC_STATS
+#define RG_MALLOC(tag, size) Alloc_Malloc((tag), (size))
+#define RG_FREE(ptr) Alloc_Free(ptr)
+/// \brief Counts memory owned by someone else, eg. the pixels of a texture.
+#define RG_TRACK(tag, bytes) Alloc_Track((tag), (bytes))
+#else
+#define RG_MALLOC(tag, size) malloc(size)
+#define RG_FREE(ptr) free(ptr)
+#define RG_TRACK(tag, bytes) ((void)0)
+#endif
+
+/// \brief malloc with a counted header, use RG_MALLOC instead.
+void* Alloc_Malloc(AllocTag tag, size_t size);
+/// \brief Frees a block of Alloc_Malloc, use RG_FREE instead.
+void Alloc_Free(void* ptr);
+/// \brief Adds (or with negative bytes removes) externally owned memory to the counters.
+void Alloc_Track(AllocTag tag, Sint64 bytes);
+/// \brief Reads the counters of a subsystem, they are all 0 without RGUI_ALLOC_STATS.
+AllocStats Alloc_GetStats(AllocTag tag);
+
+#endif
@@ -0,0 +1,164 @@
+#include <string.h>
+
+#include "Alloc.h"
+#include "CommandQueue.h"
+
+typedef enum CommandType {
+	CommandSetColor,
+	CommandMove,
+	CommandAddChild,
+	CommandRemove,
+	CommandSetTexture,
+	CommandSetZ
+} CommandType;
+
+typedef struct Command {
+	/// \brief The next command, written by the producer which posted it.
+	void* next;
+	CommandType type;
+	UIElemHandle target;
+	union {
+		Uint32 color;
+		int z;
+		Vec2 position;
+		UIElem* child;
+		char tex_path[51];
+	} arg;
+} Command;
+
+static Command* Command_New(CommandType type, UIElemHandle target) {
+	Command* cmd = RG_MALLOC(AllocOther, sizeof(Command));
+	if (cmd == NULL) exit(MALLOC_FAILED);
+	cmd->next = NULL;
+	cmd->type = type;
+	cmd->target = target;
+	return cmd;
+}
+
+/// \brief Wait-free: one exchange of the head, then the link from the previous command.
+static void Push(CommandQueue* queue, Command* cmd) {
+	cmd->next = NULL;
+	Command* prev = SDL_AtomicSetPtr(&queue->head, cmd);
+	SDL_AtomicSetPtr(&prev->next, cmd);
+}
+static void Post(CommandQueue* queue, Command* cmd) {
+	Push(queue, cmd);
+	SDL_AtomicIncRef(&queue->pending);
+}
+
+/// \brief Takes the oldest command, NULL if there is none or a producer is between its two steps.
+static Command* Pop(CommandQueue* queue) {
+	Command* tail = queue->tail;
+	Command* next = SDL_AtomicGetPtr(&tail->next);
+
+	if (tail == queue->stub) {
+		if (next == NULL) return NULL;
+		queue->tail = tail = next;
+		next = SDL_AtomicGetPtr(&tail->next);
+	}
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+	if (tail != SDL_AtomicGetPtr(&queue->head)) return NULL;
+
+	// tail is the last one, the stub is put behind it so it can be taken
+	Push(queue, queue->stub);
+	next = SDL_AtomicGetPtr(&tail->next);
+	if (next != NULL) {
+		queue->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+void CommandQueue_Init(CommandQueue* queue) {
+	queue->stub = Command_New(CommandRemove, 0);
+	queue->head = queue->stub;
+	queue->tail = queue->stub;
+	SDL_AtomicSet(&queue->pending, 0);
+}
+
+void CommandQueue_Free(CommandQueue* queue) {
+	Command* cmd;
+	while ((cmd = Pop(queue)) != NULL) {
+		if (cmd->type == CommandAddChild) UIElem_Delete(cmd->arg.child);
+		RG_FREE(cmd);
+	}
+	RG_FREE(queue->stub);
+}
+
+static void Apply(Command* cmd, UIContext* ctx) {
+	UIElem* uie = UIElem_Resolve(cmd->target);
+	if (uie == NULL) {
+		// The target (or an ancestor) was deleted after the command was posted
+		if (cmd->type == CommandAddChild) UIElem_Delete(cmd->arg.child);
+		return;
+	}
+	switch (cmd->type) {
+		case CommandSetColor:
+			uie->color = cmd->arg.color;
+			break;
+		case CommandMove:
+			uie->rel_position = cmd->arg.position;
+			UIElem_Update(uie);
+			break;
+		case CommandAddChild:
+			// Before linking, so the siblings aren't visited
+			UIElem_LoadTextures(ctx, cmd->arg.child);
+			UIElem_AddChild(uie, cmd->arg.child);
+			break;
+		case CommandRemove:
+			UIElem_Delete(uie);
+			break;
+		case CommandSetTexture:
+			UIElem_SetTexture(ctx, uie, cmd->arg.tex_path);
+			break;
+		case CommandSetZ:
+			UIElem_SetZ(uie, cmd->arg.z);
+			break;
+	}
+}
+
+void CommandQueue_Apply(CommandQueue* queue, UIContext* ctx) {
+	// Only the commands posted before the frame, so busy producers can't starve the rendering
+	int count = SDL_AtomicGet(&queue->pending);
+
+	for (int i = 0; i < count; ++i) {
+		Command* cmd = Pop(queue);
+		if (cmd == NULL) break;
+		SDL_AtomicAdd(&queue->pending, -1);
+		Apply(cmd, ctx);
+		RG_FREE(cmd);
+	}
+}
+
+void CommandQueue_SetColor(CommandQueue* queue, UIElemHandle uie, Uint32 color) {
+	Command* cmd = Command_New(CommandSetColor, uie);
+	cmd->arg.color = color;
+	Post(queue, cmd);
+}
+void CommandQueue_Move(CommandQueue* queue, UIElemHandle uie, Vec2 position) {
+	Command* cmd = Command_New(CommandMove, uie);
+	cmd->arg.position = position;
+	Post(queue, cmd);
+}
+void CommandQueue_AddChild(CommandQueue* queue, UIElemHandle parent, UIElem* child) {
+	Command* cmd = Command_New(CommandAddChild, parent);
+	cmd->arg.child = child;
+	Post(queue, cmd);
+}
+void CommandQueue_Remove(CommandQueue* queue, UIElemHandle uie) {
+	Post(queue, Command_New(CommandRemove, uie));
+}
+void CommandQueue_SetTexture(CommandQueue* queue, UIElemHandle uie, char* tex_path) {
+	Command* cmd = Command_New(CommandSetTexture, uie);
+	strncpy(cmd->arg.tex_path, tex_path, 50);
+	cmd->arg.tex_path[50] = '\0';
+	Post(queue, cmd);
+}
+void CommandQueue_SetZ(CommandQueue* queue, UIElemHandle uie, int z) {
+	Command* cmd = Command_New(CommandSetZ, uie);
+	cmd->arg.z = z;
+	Post(queue, cmd);
+}
@@ -0,0 +1,49 @@
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+/// \brief Mutations of the UI posted from any thread, applied by the main thread.
+///
+/// A lock-free multi-producer single-consumer queue: posting never blocks,
+/// the main thread applies every command posted before the start of the frame
+/// in one batch (RGUI_Render does it). The targets are given by their handles
+/// (see UIElem_Handle), which are only resolved when the command is applied, so
+/// the producers never touch the elements and a target can be deleted in any way
+/// before then, the command is skipped.
+typedef struct CommandQueue {
+	/// \brief The last posted command, swapped atomically by the producers.
+	void* head;
+	/// \brief The next command to apply, only used by the main thread.
+	struct Command* tail;
+	/// \brief The number of posted but not yet applied commands.
+	SDL_atomic_t pending;
+	/// \brief Placeholder node, the queue is never empty.
+	struct Command* stub;
+} CommandQueue;
+
+/// \brief Initializes an empty queue.
+void CommandQueue_Init(CommandQueue* queue);
+/// \brief Frees the commands which weren't applied, and the stub.
+void CommandQueue_Free(CommandQueue* queue);
+/// \brief Applies the commands posted until now, on the thread driving the window of ctx.
+void CommandQueue_Apply(CommandQueue* queue, UIContext* ctx);
+
+/// \brief Posts a change of the element's color.
+void CommandQueue_SetColor(CommandQueue* queue, UIElemHandle uie, Uint32 color);
+/// \brief Posts a change of the element's position relative to its parent.
+void CommandQueue_Move(CommandQueue* queue, UIElemHandle uie, Vec2 position);
+/// \brief Posts adding a detached element (eg. from UIElem_Init) to the parent,
+/// its textures are loaded by the main thread. The child belongs to the queue from now on,
+/// it's deleted if the parent is deleted first.
+void CommandQueue_AddChild(CommandQueue* queue, UIElemHandle parent, UIElem* child);
+/// \brief Posts deleting the element and its children.
+void CommandQueue_Remove(CommandQueue* queue, UIElemHandle uie);
+/// \brief Posts replacing the texture of the element, loaded by the main thread.
+void CommandQueue_SetTexture(CommandQueue* queue, UIElemHandle uie, char* tex_path);
+/// \brief Posts a change of the element's stacking order among its siblings.
+void CommandQueue_SetZ(CommandQueue* queue, UIElemHandle uie, int z);
+
+#endif
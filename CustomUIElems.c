@@ -1,5 +1,190 @@
+#include <stdint.h>
+
+#include <stdio.h>
+
+#include "Alloc.h"
 #include "CustomUIElems.h"
+#include "RGUI.h"
+#include "Text.h"
+
+
+void CustomUIElems_Register(void) {
+	RGUI_RegisterType("button", Make_Button);
+	RGUI_RegisterType("text", Make_Text);
+}
+
+/* Button */
+
+/// \brief The payload of a button, the color is XOR-ed with mask on enter and on leave.
+typedef struct ButtonData {
+	Uint32 mask;
+} ButtonData;
+
+static void Button_Highlight(UIElem* uie) {
+	// The instances of a template get a copy of the payload, only the elements without the builder have none
+	uie->color ^= uie->data != NULL ? ((ButtonData*)uie->data)->mask : 0xffffff00;
+}
 
 void Make_Button(UIElem *uie) {
+	ButtonData* button = RG_MALLOC(AllocTree, sizeof(ButtonData));
+	if (button == NULL) exit(MALLOC_FAILED);
+	button->mask = 0xffffff00;
+
+	int r, g, b, a;
+	if (uie->data != NULL) {
+		if (sscanf(uie->data, "%d %d %d %d", &r, &g, &b, &a) == 4) {
+			button->mask = uie->color ^ ((Uint8)r << 24 | (Uint8)g << 16 | (Uint8)b << 8 | (Uint8)a);
+		}
+		RG_FREE(uie->data);
+	}
+	uie->data = button;
+	uie->data_size = sizeof(ButtonData);
+
+	UIElem_AddCallback(uie, uie->name, MouseEnter, Button_Highlight);
+	UIElem_AddCallback(uie, uie->name, MouseLeave, Button_Highlight);
+}
+
+/* Scroll list */
+
+/// \brief px scrolled by one notch of the mouse wheel.
+#define SCROLL_LIST_WHEEL_STEP 40
+/// \brief Marks a row of the pool which isn't bound to any index.
+#define SCROLL_LIST_UNBOUND SIZE_MAX
+
+typedef struct ScrollListRow {
+	UIElem* elem;
+	size_t index;
+} ScrollListRow;
+
+/// \brief Stored in UIElem.data, the rows are allocated with it so one RG_FREE() releases everything.
+typedef struct ScrollListData {
+	Sint64 offset;
+	int row_height;
+	size_t row_count;
+	ScrollList_RowFiller fill;
+	void* user;
+
+	Sint32 drag_mouse_y;
+	Sint64 drag_offset;
+
+	size_t pool_size;
+	ScrollListRow rows[];
+} ScrollListData;
+
+static Sint64 ScrollList_MaxOffset(UIElem* uie) {
+	ScrollListData* sl = uie->data;
+	Sint64 max = (Sint64)sl->row_count * sl->row_height - uie->size.Y;
+	return max > 0 ? max : 0;
+}
+
+/// \brief Binds the pool to the rows intersecting the viewport.
+///
+/// The row at index always lives in rows[index % pool_size], so scrolling
+/// by a few rows only refills the rows which came into view.
+static void ScrollList_Layout(UIElem* uie) {
+	ScrollListData* sl = uie->data;
+	size_t first = (size_t)(sl->offset / sl->row_height);
+
+	for (size_t i = 0; i < sl->pool_size; ++i) {
+		size_t index = first + i;
+		ScrollListRow* row = &sl->rows[index % sl->pool_size];
+
+		if (index >= sl->row_count) {
+			// Parked outside the list with no size, so it's neither drawn nor hit.
+			if (row->index == SCROLL_LIST_UNBOUND && row->elem->size.Y == 0) continue;
+			row->index = SCROLL_LIST_UNBOUND;
+			row->elem->rel_position = (Vec2){ -1, -1 };
+			row->elem->size = (Vec2){ 0, 0 };
+			UIElem_Update(row->elem);
+			continue;
+		}
+
+		if (row->index != index) {
+			row->index = index;
+			row->elem->size = (Vec2){ uie->size.X, sl->row_height };
+			if (sl->fill != NULL) sl->fill(row->elem, index, sl->user);
+		}
+
+		Vec2 position = { 0, (int)((Sint64)index * sl->row_height - sl->offset) };
+		if (!Vec2_Compare(row->elem->rel_position, position)) {
+			row->elem->rel_position = position;
+			UIElem_Update(row->elem);
+		}
+	}
+}
+
+static void ScrollList_OnScroll(UIElem* uie) {
+	ScrollList_ScrollTo(uie, ((ScrollListData*)uie->data)->offset - (Sint64)UIEvent_Current()->wheel_y * SCROLL_LIST_WHEEL_STEP);
+	UIEvent_StopPropagation();
+}
+static void ScrollList_OnLMBDown(UIElem* uie) {
+	ScrollListData* sl = uie->data;
+	sl->drag_mouse_y = UIEvent_Current()->y;
+	sl->drag_offset = sl->offset;
+	// The drag goes on outside the list too
+	UIEvent_CapturePointer();
+}
+static void ScrollList_OnDrag(UIElem* uie) {
+	ScrollListData* sl = uie->data;
+	UIEvent* event = UIEvent_Current();
+	// Only the list's own drag, not one bubbling up from a capturing row
+	if (event->target != uie) return;
+	ScrollList_ScrollTo(uie, sl->drag_offset - ((Sint64)event->y - sl->drag_mouse_y));
+}
+static void ScrollList_OnTick(UIElem* uie) {
+	ScrollList_Layout(uie);
+}
+
+UIElem* ScrollList_Init(Vec2 position, Vec2 size, Uint32 color, char* name,
+	int row_height, size_t row_count, ScrollList_RowFiller fill, void* user) {
+	UIElem* uie = UIElem_Init(position, size, "", color, name);
+	if (row_height < 1) row_height = 1;
+
+	// Enough rows to cover the viewport when the first one is partially scrolled out
+	size_t pool_size = size.Y / row_height + 2;
+	ScrollListData* sl = RG_MALLOC(AllocTree, sizeof(ScrollListData) + pool_size * sizeof(ScrollListRow));
+	if (sl == NULL) exit(MALLOC_FAILED);
+
+	sl->offset = 0;
+	sl->row_height = row_height;
+	sl->row_count = row_count;
+	sl->fill = fill;
+	sl->user = user;
+	sl->drag_mouse_y = 0;
+	sl->drag_offset = 0;
+	sl->pool_size = pool_size;
+
+	for (size_t i = 0; i < pool_size; ++i) {
+		sl->rows[i].elem = UIElem_Init((Vec2){ -1, -1 }, (Vec2){ 0, 0 }, "", 0x00000000, "row");
+		sl->rows[i].index = SCROLL_LIST_UNBOUND;
+		UIElem_AddChild(uie, sl->rows[i].elem);
+	}
+
+	uie->data = sl;
+
+	UIElem_AddCallback(uie, uie->name, Scroll, ScrollList_OnScroll);
+	UIElem_AddCallback(uie, uie->name, LMBDown, ScrollList_OnLMBDown);
+	UIElem_AddCallback(uie, uie->name, Drag, ScrollList_OnDrag);
+	UIElem_AddCallback(uie, uie->name, Tick, ScrollList_OnTick);
+
+	ScrollList_Layout(uie);
+	return uie;
+}
+
+void ScrollList_SetRowCount(UIElem* uie, size_t row_count) {
+	ScrollListData* sl = uie->data;
+	sl->row_count = row_count;
+	for (size_t i = 0; i < sl->pool_size; ++i) sl->rows[i].index = SCROLL_LIST_UNBOUND;
+	ScrollList_ScrollTo(uie, sl->offset);
+}
+
+void ScrollList_ScrollTo(UIElem* uie, Sint64 offset) {
+	ScrollListData* sl = uie->data;
+	Sint64 max = ScrollList_MaxOffset(uie);
+
+	if (offset > max) offset = max;
+	if (offset < 0) offset = 0;
+	sl->offset = offset;
 
+	ScrollList_Layout(uie);
 }
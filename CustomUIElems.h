@@ -5,9 +5,45 @@
 /// \brief Some predefined elements.
 typedef enum UIElem_Types {
 	Div,
-	Button
+	Button,
+	ScrollList,
+	Text
 } UIElem_Types;
 
+/// \brief Registers the builders of the predefined elements for RGML, should be called before loading a window.
+///
+/// "button": highlighted while hovered, the data is the "r g b a" highlight color,
+/// without data the color gets inverted.
+/// "text": the data is "font.ttf pt_size string", the color is the color of the text (see Text.h).
+void CustomUIElems_Register(void);
+
+/// \brief The builder of "button".
 void Make_Button(UIElem* uie);
 
-#endif
\ No newline at end of file
+/* Scroll list */
+
+/// \brief Fills a recycled row element with the content of the row at index.
+///
+/// Called only when a row of the pool gets bound to a new index,
+/// so the cost of scrolling doesn't depend on the length of the list.
+typedef void (*ScrollList_RowFiller)(UIElem* row, size_t index, void* user);
+
+/// \brief Creates a vertical list which only keeps the visible rows alive.
+///
+/// The rows are a pool of children recycled while scrolling, the list itself
+/// stores only the scroll state, so the memory doesn't grow with row_count.
+/// Scrolls on the mouse wheel and when dragged with the left mouse button,
+/// the list takes the pointer capture on LMBDown, so it gets the Drag events.
+///
+/// \param row_height	The height of every row in px.
+/// \param row_count	The number of rows in the list.
+/// \param fill		Called when a row is bound to an index.
+/// \param user		Passed to fill.
+UIElem* ScrollList_Init(Vec2 position, Vec2 size, Uint32 color, char* name,
+	int row_height, size_t row_count, ScrollList_RowFiller fill, void* user);
+/// \brief Changes the length of the list, rebinds every row.
+void ScrollList_SetRowCount(UIElem* uie, size_t row_count);
+/// \brief Scrolls so the top of the viewport is offset px from the top of the list.
+void ScrollList_ScrollTo(UIElem* uie, Sint64 offset);
+
+#endif
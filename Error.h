@@ -6,5 +6,7 @@
 #define MALLOC_FAILED 4
 #define INVALID_RGML 5
 #define FILE_READ_ERROR 6
+#define UNKNOWN_HANDLER 7
+#define REGISTRY_FULL 8
 
 #endif
\ No newline at end of file
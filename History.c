@@ -0,0 +1,387 @@
+#include "Alloc.h"
+#include "History.h"
+#include "Text.h"
+
+/// \brief The text and the copyable payload of an element when it started being tracked.
+typedef struct HistoryShared {
+	int refs;
+	UIElemText* text;
+	void* data;
+	size_t data_size;
+} HistoryShared;
+
+/* Nodes */
+
+static HistoryNode* Node_Alloc(size_t n_children) {
+	HistoryNode* node = RG_MALLOC(AllocOther, sizeof(HistoryNode) + n_children * sizeof(HistoryNode*));
+	if (node == NULL) exit(MALLOC_FAILED);
+	node->refs = 1;
+	node->n_children = n_children;
+	return node;
+}
+
+/// \brief A copy of the properties with room for n_children, the children are filled by the caller.
+static HistoryNode* Node_Props(HistoryNode* node, size_t n_children) {
+	HistoryNode* copy = Node_Alloc(n_children);
+	memcpy(copy, node, sizeof(HistoryNode));
+	copy->refs = 1;
+	copy->n_children = n_children;
+	if (copy->callbacks != NULL) ++copy->callbacks->refs;
+	if (copy->shared != NULL) ++copy->shared->refs;
+	return copy;
+}
+/// \brief A copy sharing the children of node, with room for extra more.
+static HistoryNode* Node_Copy(HistoryNode* node, size_t extra) {
+	HistoryNode* copy = Node_Props(node, node->n_children + extra);
+	for (size_t i = 0; i < node->n_children; ++i) {
+		copy->children[i] = node->children[i];
+		++copy->children[i]->refs;
+	}
+	return copy;
+}
+
+void History_Release(HistoryNode* node) {
+	if (node == NULL || --node->refs > 0) return;
+	for (size_t i = 0; i < node->n_children; ++i) History_Release(node->children[i]);
+	UIElem_ReleaseCallbacks(node->callbacks);
+	if (node->shared != NULL && --node->shared->refs == 0) {
+		Text_Free(node->shared->text);
+		if (node->shared->data != NULL) RG_FREE(node->shared->data);
+		RG_FREE(node->shared);
+	}
+	RG_FREE(node);
+}
+
+static void Node_SetProps(HistoryNode* node, UIElem* uie) {
+	strcpy(node->name, uie->name);
+	node->rel_position = uie->rel_position;
+	node->size = uie->size;
+	node->color = uie->color;
+	strncpy(node->tex_path, UIElem_TexPath(uie), 50);
+	node->tex_path[50] = '\0';
+	node->z = uie->z;
+	node->clip = uie->clip;
+	node->from_rgml = uie->from_rgml;
+}
+/// \brief A copy of the payload if it has a data_size, otherwise NULL.
+static void* Data_Copy(void* data, size_t data_size) {
+	if (data == NULL || data_size == 0) return NULL;
+	void* copy = RG_MALLOC(AllocTree, data_size);
+	if (copy == NULL) exit(MALLOC_FAILED);
+	memcpy(copy, data, data_size);
+	return copy;
+}
+/// \brief Keeps the callbacks, the text and the payload of the element in a new node.
+static void Node_SetShared(HistoryNode* node, UIElem* uie) {
+	node->callbacks = uie->callbacks;
+	if (node->callbacks != NULL) ++node->callbacks->refs;
+	node->shared = NULL;
+	void* data = Data_Copy(uie->data, uie->data_size);
+	if (uie->text == NULL && data == NULL) return;
+	node->shared = RG_MALLOC(AllocOther, sizeof(HistoryShared));
+	if (node->shared == NULL) exit(MALLOC_FAILED);
+	node->shared->refs = 1;
+	node->shared->text = Text_Copy(uie->text);
+	node->shared->data = data;
+	node->shared->data_size = data != NULL ? uie->data_size : 0;
+}
+
+/// \brief A copy of the parent's version with the versions of its live children, in their paint order.
+static HistoryNode* Node_Children(UIElem* parent) {
+	size_t n_children = 0;
+	for (UIElem* child = parent->child; child != NULL; child = child->sibling) {
+		if (child->version != NULL) ++n_children;
+	}
+
+	HistoryNode* node = Node_Props(parent->version, n_children);
+	size_t i = 0;
+	for (UIElem* child = parent->child; child != NULL; child = child->sibling) {
+		if (child->version == NULL) continue;
+		node->children[i++] = child->version;
+		++child->version->refs;
+	}
+	return node;
+}
+
+/* Live elements */
+
+/// \brief Registers the element under the id, growing the tables if needed.
+static void Live_Put(History* history, Uint32 id, UIElem* uie) {
+	if (id >= history->capacity) {
+		Uint32 capacity = history->capacity == 0 ? 64 : history->capacity;
+		while (capacity <= id) capacity *= 2;
+
+		UIElem** live = RG_MALLOC(AllocOther, capacity * sizeof(UIElem*));
+		Uint32* seen = RG_MALLOC(AllocOther, capacity * sizeof(Uint32));
+		if (live == NULL || seen == NULL) exit(MALLOC_FAILED);
+		memset(live, 0, capacity * sizeof(UIElem*));
+		memset(seen, 0, capacity * sizeof(Uint32));
+		if (history->live != NULL) {
+			memcpy(live, history->live, history->capacity * sizeof(UIElem*));
+			memcpy(seen, history->seen, history->capacity * sizeof(Uint32));
+			RG_FREE(history->live);
+			RG_FREE(history->seen);
+		}
+		history->live = live;
+		history->seen = seen;
+		history->capacity = capacity;
+	}
+	history->live[id] = uie;
+}
+
+/// \brief Versions the element and its subtree with new ids.
+static HistoryNode* Track(History* history, UIElem* uie) {
+	size_t n_children = 0;
+	for (UIElem* child = uie->child; child != NULL; child = child->sibling) ++n_children;
+
+	HistoryNode* node = Node_Alloc(n_children);
+	node->id = history->next_id++;
+	Node_SetProps(node, uie);
+	Node_SetShared(node, uie);
+	size_t i = 0;
+	for (UIElem* child = uie->child; child != NULL; child = child->sibling) {
+		node->children[i++] = Track(history, child);
+	}
+
+	uie->version = node;
+	Live_Put(history, node->id, uie);
+	return node;
+}
+
+/// \brief Forgets the live elements of the subtree, before it's deleted.
+static void Untrack(History* history, UIElem* uie) {
+	for (UIElem* child = uie->child; child != NULL; child = child->sibling) Untrack(history, child);
+	if (uie->version == NULL) return;
+	history->live[uie->version->id] = NULL;
+	uie->version = NULL;
+}
+
+/// \brief Makes node the version of uie, copying the versions of the ancestors up to the root.
+///
+/// \param node	The new version of uie, its reference is taken over.
+static void Commit(History* history, UIElem* uie, HistoryNode* node) {
+	HistoryNode* old = uie->version;
+	uie->version = node;
+
+	for (UIElem* parent = uie->parent; parent != NULL && parent->version != NULL; parent = parent->parent) {
+		HistoryNode* copy = Node_Copy(parent->version, 0);
+		for (size_t i = 0; i < copy->n_children; ++i) {
+			if (copy->children[i] != old) continue;
+			History_Release(old);
+			copy->children[i] = node;
+			break;
+		}
+		old = parent->version;
+		node = copy;
+		parent->version = copy;
+	}
+
+	// The old path is freed with the old root, unless a snapshot holds it
+	History_Release(history->current);
+	history->current = node;
+}
+
+/// \brief A changeable copy of the element's version.
+static HistoryNode* Edit(UIElem* uie) {
+	return Node_Copy(uie->version, 0);
+}
+
+/* History */
+
+void History_Init(History* history, UIContext* ctx, UIElem* root) {
+	history->ctx = ctx;
+	history->root = root;
+	history->live = NULL;
+	history->seen = NULL;
+	history->stamp = 0;
+	history->next_id = 0;
+	history->capacity = 0;
+	history->current = Track(history, root);
+}
+
+void History_Free(History* history) {
+	Untrack(history, history->root);
+	History_Release(history->current);
+	RG_FREE(history->live);
+	RG_FREE(history->seen);
+	history->current = NULL;
+	history->live = NULL;
+	history->seen = NULL;
+	history->capacity = 0;
+}
+
+HistoryNode* History_Snapshot(History* history) {
+	++history->current->refs;
+	return history->current;
+}
+
+/// \brief Creates the live subtree of the version, its positions are updated when it's linked.
+static UIElem* Build(History* history, HistoryNode* node) {
+	UIElem* uie = UIElem_Init(node->rel_position, node->size, node->tex_path, node->color, node->name);
+	uie->z = node->z;
+	uie->clip = node->clip;
+	uie->from_rgml = node->from_rgml;
+	uie->callbacks = node->callbacks;
+	if (uie->callbacks != NULL) ++uie->callbacks->refs;
+	if (node->shared != NULL) {
+		uie->text = Text_Copy(node->shared->text);
+		uie->data = Data_Copy(node->shared->data, node->shared->data_size);
+		uie->data_size = node->shared->data_size;
+	}
+	uie->version = node;
+	Live_Put(history, node->id, uie);
+
+	// Linked in the order of the version, which is the paint order
+	UIElem** link = &uie->child;
+	for (size_t i = 0; i < node->n_children; ++i) {
+		UIElem* child = Build(history, node->children[i]);
+		child->parent = uie;
+		*link = child;
+		link = &child->sibling;
+	}
+	return uie;
+}
+
+/// \brief Links the tracked children of uie in the order of its version.
+///
+/// The untracked ones go before the first tracked child with the same or higher z, like UIElem_AddChild does.
+static void Relink_Children(History* history, UIElem* uie, HistoryNode* node) {
+	UIElem* untracked = NULL;
+	UIElem** untracked_tail = &untracked;
+	for (UIElem* child = uie->child; child != NULL; child = child->sibling) {
+		if (child->version != NULL) continue;
+		*untracked_tail = child;
+		untracked_tail = &child->sibling;
+	}
+	*untracked_tail = NULL;
+
+	UIElem** link = &uie->child;
+	for (size_t i = 0; i < node->n_children; ++i) {
+		UIElem* child = history->live[node->children[i]->id];
+		*link = child;
+		link = &child->sibling;
+	}
+	*link = NULL;
+
+	while (untracked != NULL) {
+		UIElem* child = untracked;
+		untracked = child->sibling;
+		link = &uie->child;
+		while (*link != NULL && (*link)->z < child->z) link = &(*link)->sibling;
+		child->sibling = *link;
+		*link = child;
+	}
+}
+
+/// \brief Patches uie from its version old to node, the shared subtrees are skipped.
+static void Restore_Helper(History* history, UIElem* uie, HistoryNode* old, HistoryNode* node) {
+	if (old == node) return;
+	uie->version = node;
+
+	strcpy(uie->name, node->name);
+	uie->color = node->color;
+	uie->size = node->size;
+	uie->clip = node->clip;
+	UIElem_SetZ(uie, node->z);
+	if (strcmp(UIElem_TexPath(uie), node->tex_path) != 0) UIElem_SetTexture(history->ctx, uie, node->tex_path);
+	if (!Vec2_Compare(uie->rel_position, node->rel_position)) {
+		uie->rel_position = node->rel_position;
+		UIElem_Update(uie);
+	}
+
+	// The children only in the old version are deleted
+	Uint32 stamp = ++history->stamp;
+	for (size_t i = 0; i < node->n_children; ++i) history->seen[node->children[i]->id] = stamp;
+	for (size_t i = 0; i < old->n_children; ++i) {
+		UIElem* gone = history->live[old->children[i]->id];
+		if (history->seen[old->children[i]->id] == stamp || gone == NULL) continue;
+		Untrack(history, gone);
+		UIElem_Delete(gone);
+	}
+
+	for (size_t i = 0; i < node->n_children; ++i) {
+		HistoryNode* child = node->children[i];
+		UIElem* live = history->live[child->id];
+		if (live != NULL) {
+			Restore_Helper(history, live, live->version, child);
+		} else {
+			// Loaded before linking, so the siblings aren't visited
+			live = Build(history, child);
+			UIElem_LoadTextures(history->ctx, live);
+			UIElem_AddChild(uie, live);
+		}
+	}
+	Relink_Children(history, uie, node);
+}
+void History_Restore(History* history, HistoryNode* snapshot) {
+	if (snapshot == history->current) return;
+	Restore_Helper(history, history->root, history->current, snapshot);
+
+	++snapshot->refs;
+	History_Release(history->current);
+	history->current = snapshot;
+}
+
+/* Versioned changes */
+
+void History_SetColor(History* history, UIElem* uie, Uint32 color) {
+	if (uie->color == color) return;
+	uie->color = color;
+	HistoryNode* node = Edit(uie);
+	node->color = color;
+	Commit(history, uie, node);
+}
+
+void History_Move(History* history, UIElem* uie, Vec2 position) {
+	if (Vec2_Compare(uie->rel_position, position)) return;
+	uie->rel_position = position;
+	UIElem_Update(uie);
+	HistoryNode* node = Edit(uie);
+	node->rel_position = position;
+	Commit(history, uie, node);
+}
+
+void History_Resize(History* history, UIElem* uie, Vec2 size) {
+	if (Vec2_Compare(uie->size, size)) return;
+	uie->size = size;
+	HistoryNode* node = Edit(uie);
+	node->size = size;
+	Commit(history, uie, node);
+}
+
+void History_SetZ(History* history, UIElem* uie, int z) {
+	if (uie->z == z) return;
+	UIElem_SetZ(uie, z);
+	HistoryNode* node = Edit(uie);
+	node->z = z;
+	Commit(history, uie, node);
+	// The element was relinked, the parent's version follows the new paint order
+	if (uie->parent != NULL && uie->parent->version != NULL) Commit(history, uie->parent, Node_Children(uie->parent));
+}
+
+void History_SetTexture(History* history, UIElem* uie, char* tex_path) {
+	if (strcmp(UIElem_TexPath(uie), tex_path) == 0) return;
+	UIElem_SetTexture(history->ctx, uie, tex_path);
+	HistoryNode* node = Edit(uie);
+	strncpy(node->tex_path, tex_path, 50);
+	node->tex_path[50] = '\0';
+	Commit(history, uie, node);
+}
+
+void History_AddChild(History* history, UIElem* parent, UIElem* child) {
+	UIElem_AddChild(parent, child);
+	HistoryNode* tracked = Track(history, child);
+	// In its place in the paint order, the reference of Track moves into the parent's version
+	HistoryNode* node = Node_Children(parent);
+	History_Release(tracked);
+	Commit(history, parent, node);
+}
+
+void History_Remove(History* history, UIElem* uie) {
+	UIElem* parent = uie->parent;
+	HistoryNode* removed = uie->version;
+	Untrack(history, uie);
+	UIElem_Delete(uie);
+	if (removed == NULL || parent == NULL || parent->version == NULL) return;
+	Commit(history, parent, Node_Children(parent));
+}
@@ -0,0 +1,88 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+/// \brief An immutable version of an element and its subtree, shared by every version it didn't change in.
+///
+/// Holds the properties of the element (name, position, size, color, texture path,
+/// z, clip) and the versions of its children in their paint order.
+/// The callbacks, the text and the payload (if it has a data_size) are kept as they were
+/// when the element started being tracked, to create it again after it was removed,
+/// but their changes aren't versioned.
+typedef struct HistoryNode {
+	/// \brief The same in every version of the element.
+	Uint32 id;
+	/// \brief The parents and the snapshots holding it.
+	int refs;
+	char name[20 + 1];
+	Vec2 rel_position;
+	Vec2 size;
+	Uint32 color;
+	char tex_path[50 + 1];
+	int z;
+	bool clip;
+	bool from_rgml;
+	/// \brief A reference to the shared callback set, NULL if there are none.
+	UIElemCallbacks* callbacks;
+	/// \brief The text and the payload with a data_size, shared by the versions of the element, NULL if it has neither.
+	struct HistoryShared* shared;
+	size_t n_children;
+	struct HistoryNode* children[];
+} HistoryNode;
+
+/// \brief The versions of a tree, for undo and rollback.
+///
+/// Only the changes made through the History functions are versioned: a change
+/// copies the node of the element and its ancestors, everything else is shared,
+/// so a snapshot is a reference to the root and the memory grows with the edits.
+/// Restoring patches only the live elements whose versions differ.
+/// Tracked elements should be removed with History_Remove, and only from the main thread.
+/// The snapshots hold the texts laid out in the window, release them before it's freed.
+typedef struct History {
+	UIContext* ctx;
+	/// \brief The live root of the tree.
+	UIElem* root;
+	/// \brief The version of the live tree.
+	HistoryNode* current;
+	/// \brief The live elements by id, NULL if the element isn't in the live tree.
+	UIElem** live;
+	/// \brief Marks the ids of the children of a node during History_Restore.
+	Uint32* seen;
+	Uint32 stamp;
+	Uint32 next_id;
+	Uint32 capacity;
+} History;
+
+/// \brief Starts tracking the tree, versioning every element in it.
+void History_Init(History* history, UIContext* ctx, UIElem* root);
+/// \brief Stops tracking the tree, the snapshots still have to be released.
+void History_Free(History* history);
+
+/// \brief The current version, O(1), release it with History_Release.
+HistoryNode* History_Snapshot(History* history);
+/// \brief Makes the live tree look like the snapshot, the snapshot stays valid.
+///
+/// Elements removed since then are created again with the versioned properties,
+/// the ones added since then are deleted.
+void History_Restore(History* history, HistoryNode* snapshot);
+/// \brief Releases a snapshot.
+void History_Release(HistoryNode* snapshot);
+
+/* Versioned changes, the element must be in the tracked tree */
+
+void History_SetColor(History* history, UIElem* uie, Uint32 color);
+/// \brief Changes the position relative to the parent.
+void History_Move(History* history, UIElem* uie, Vec2 position);
+void History_Resize(History* history, UIElem* uie, Vec2 size);
+void History_SetZ(History* history, UIElem* uie, int z);
+void History_SetTexture(History* history, UIElem* uie, char* tex_path);
+/// \brief Adds a detached element (and its children) to the parent and starts tracking it.
+void History_AddChild(History* history, UIElem* parent, UIElem* child);
+/// \brief Deletes the element and its children, the snapshots keep their versions.
+void History_Remove(History* history, UIElem* uie);
+
+#endif
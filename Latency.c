@@ -0,0 +1,191 @@
+#include <stdio.h>
+
+#include "Latency.h"
+
+/// \brief Every power of two range of µs is split into this many buckets.
+#define LATENCY_SUB_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+/// \brief Covers up to 2^32 µs (~71 minutes), everything above goes into the last bucket.
+#define LATENCY_N_BUCKETS (LATENCY_SUB_BUCKETS * (32 - LATENCY_SUB_BITS + 1))
+/// \brief Input events waiting for the next present.
+#define LATENCY_MAX_PENDING 256
+
+/// \brief Guards everything below, the events come from the event loop and the frames are presented by the render threads.
+static SDL_SpinLock _Lock = 0;
+static Uint64 _Histogram[LATENCY_N_BUCKETS] = { 0 };
+static Uint64 _Count = 0;
+static Uint64 _Dropped = 0;
+static Uint64 _Max_Us = 0;
+
+/// \brief Performance counter values of the input events since the last present.
+static Uint64 _Pending[LATENCY_MAX_PENDING];
+static size_t _N_Pending = 0;
+
+/// \brief Values below 2^SUB_BITS get their own bucket,
+/// above that every power of two is split into SUB_BUCKETS equal parts.
+static size_t Bucket_Index(Uint64 us) {
+	if (us >= ((Uint64)1 << 32)) return LATENCY_N_BUCKETS - 1;
+	if (us < LATENCY_SUB_BUCKETS) return (size_t)us;
+
+	int msb = 31;
+	while (!(us & ((Uint64)1 << msb))) --msb;
+	int shift = msb - LATENCY_SUB_BITS;
+
+	return (size_t)(shift + 1) * LATENCY_SUB_BUCKETS + (size_t)((us >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+static Uint64 Bucket_Lower(size_t index) {
+	if (index < LATENCY_SUB_BUCKETS) return index;
+	int shift = (int)(index / LATENCY_SUB_BUCKETS) - 1;
+	return (Uint64)(LATENCY_SUB_BUCKETS + index % LATENCY_SUB_BUCKETS) << shift;
+}
+static Uint64 Bucket_Upper(size_t index) {
+	if (index + 1 >= LATENCY_N_BUCKETS) return _Max_Us;
+	return Bucket_Lower(index + 1);
+}
+
+static bool Is_Input(Uint32 type) {
+	// The keyboard, text input and mouse events
+	return type >= SDL_KEYDOWN && type < SDL_JOYAXISMOTION;
+}
+
+void Latency_Input(const SDL_Event* ev) {
+	if (!Is_Input(ev->type)) return;
+
+	// SDL stamps the events in ms when they arrive, convert that to
+	// the performance counter so the time spent in the app is precise.
+	Uint64 now = SDL_GetPerformanceCounter();
+	Uint32 age_ms = SDL_GetTicks() - ev->common.timestamp;
+	if (age_ms > 1000) age_ms = 0;
+	Uint64 stamp = now - age_ms * SDL_GetPerformanceFrequency() / 1000;
+
+	SDL_AtomicLock(&_Lock);
+	if (_N_Pending == LATENCY_MAX_PENDING) {
+		++_Dropped;
+	} else {
+		_Pending[_N_Pending++] = stamp;
+	}
+	SDL_AtomicUnlock(&_Lock);
+}
+
+/// \brief Latency_Record, with the lock held.
+static void Record(const Uint64* stamps, size_t n) {
+	if (n == 0) return;
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	Uint64 freq = SDL_GetPerformanceFrequency();
+
+	for (size_t i = 0; i < n; ++i) {
+		Uint64 us = (now - stamps[i]) * 1000000 / freq;
+		++_Histogram[Bucket_Index(us)];
+		++_Count;
+		if (us > _Max_Us) _Max_Us = us;
+	}
+}
+
+void Latency_Present(void) {
+	SDL_AtomicLock(&_Lock);
+	Record(_Pending, _N_Pending);
+	_N_Pending = 0;
+	SDL_AtomicUnlock(&_Lock);
+}
+
+size_t Latency_TakePending(Uint64* stamps, size_t max) {
+	SDL_AtomicLock(&_Lock);
+	size_t n = _N_Pending < max ? _N_Pending : max;
+	for (size_t i = 0; i < n; ++i) stamps[i] = _Pending[i];
+	_Dropped += _N_Pending - n;
+	_N_Pending = 0;
+	SDL_AtomicUnlock(&_Lock);
+	return n;
+}
+
+void Latency_Record(const Uint64* stamps, size_t n) {
+	SDL_AtomicLock(&_Lock);
+	Record(stamps, n);
+	SDL_AtomicUnlock(&_Lock);
+}
+
+void Latency_Reset(void) {
+	SDL_AtomicLock(&_Lock);
+	for (size_t i = 0; i < LATENCY_N_BUCKETS; ++i) _Histogram[i] = 0;
+	_Count = 0;
+	_Dropped = 0;
+	_Max_Us = 0;
+	_N_Pending = 0;
+	SDL_AtomicUnlock(&_Lock);
+}
+
+Uint64 Latency_Count(void) {
+	SDL_AtomicLock(&_Lock);
+	Uint64 count = _Count;
+	SDL_AtomicUnlock(&_Lock);
+	return count;
+}
+Uint64 Latency_Dropped(void) {
+	SDL_AtomicLock(&_Lock);
+	Uint64 dropped = _Dropped;
+	SDL_AtomicUnlock(&_Lock);
+	return dropped;
+}
+
+/// \brief Latency_Percentile, with the lock held.
+static double Percentile(double p) {
+	if (_Count == 0) return 0.0;
+	if (p < 0.0) p = 0.0;
+	if (p > 100.0) p = 100.0;
+
+	Uint64 rank = (Uint64)(p / 100.0 * (double)(_Count - 1)) + 1;
+	Uint64 seen = 0;
+
+	for (size_t i = 0; i < LATENCY_N_BUCKETS; ++i) {
+		seen += _Histogram[i];
+		if (seen >= rank) {
+			// The middle of the bucket, but never more than the real maximum
+			Uint64 upper = Bucket_Upper(i);
+			double us = (Bucket_Lower(i) + upper) / 2.0;
+			if (us > _Max_Us) us = (double)_Max_Us;
+			return us / 1000.0;
+		}
+	}
+	return _Max_Us / 1000.0;
+}
+double Latency_Percentile(double p) {
+	SDL_AtomicLock(&_Lock);
+	double ms = Percentile(p);
+	SDL_AtomicUnlock(&_Lock);
+	return ms;
+}
+
+double Latency_Max(void) {
+	SDL_AtomicLock(&_Lock);
+	double ms = _Max_Us / 1000.0;
+	SDL_AtomicUnlock(&_Lock);
+	return ms;
+}
+
+bool Latency_Export(char* file_name) {
+	FILE* out = fopen(file_name, "w");
+	if (out == NULL) return false;
+
+	SDL_AtomicLock(&_Lock);
+	fprintf(out, "count %llu\n", (unsigned long long)_Count);
+	fprintf(out, "dropped %llu\n", (unsigned long long)_Dropped);
+	fprintf(out, "p50_ms %.3f\n", Percentile(50.0));
+	fprintf(out, "p95_ms %.3f\n", Percentile(95.0));
+	fprintf(out, "p99_ms %.3f\n", Percentile(99.0));
+	fprintf(out, "max_ms %.3f\n", _Max_Us / 1000.0);
+	fprintf(out, "\nfrom_us to_us count\n");
+
+	for (size_t i = 0; i < LATENCY_N_BUCKETS; ++i) {
+		if (_Histogram[i] == 0) continue;
+		fprintf(out, "%llu %llu %llu\n",
+			(unsigned long long)Bucket_Lower(i),
+			(unsigned long long)Bucket_Upper(i),
+			(unsigned long long)_Histogram[i]
+		);
+	}
+	SDL_AtomicUnlock(&_Lock);
+
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,41 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/// \brief Input-to-photon latency tracking.
+///
+/// Every input event is stamped when it is taken from the SDL queue,
+/// the stamp waits until the next presented frame (which includes the effects
+/// of hit-testing, the callbacks and the drawing of that event),
+/// then the elapsed time goes into a log-linear histogram with ~3% precision.
+/// The state is process-wide and locked, so the functions can be called from any thread.
+
+/// \brief Should be called on every event taken from the SDL queue, ignores non-input events.
+void Latency_Input(const SDL_Event* ev);
+/// \brief Should be called right after SDL_RenderPresent, records the pending events.
+void Latency_Present(void);
+/// \brief Moves the stamps of the pending events into stamps, for frames presented by another thread.
+///
+/// \return The number of stamps taken, at most max.
+size_t Latency_TakePending(Uint64* stamps, size_t max);
+/// \brief Records the latencies of stamps taken with Latency_TakePending, when their frame is presented.
+void Latency_Record(const Uint64* stamps, size_t n);
+/// \brief Clears the histogram and the pending events.
+void Latency_Reset(void);
+
+/// \brief The number of recorded latencies.
+Uint64 Latency_Count(void);
+/// \brief The number of input events which didn't fit into the pending buffer.
+Uint64 Latency_Dropped(void);
+/// \brief The latency in ms below which p percent (0-100) of the recorded latencies are.
+double Latency_Percentile(double p);
+/// \brief The largest recorded latency in ms.
+double Latency_Max(void);
+/// \brief Writes the p50/p95/p99 summary and the non-empty buckets to a text file.
+///
+/// \return false if the file can't be opened.
+bool Latency_Export(char* file_name);
+
+#endif
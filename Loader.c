@@ -0,0 +1,89 @@
+#include <stdbool.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "Loader.h"
+
+typedef struct LoaderNode {
+	LoaderJob job;
+	void* data;
+	struct LoaderNode* next;
+} LoaderNode;
+
+/// \brief Guards the creation of the thread, the jobs can be posted from the loader thread too.
+static SDL_SpinLock _Start_Lock = 0;
+static SDL_Thread* _Thread = NULL;
+/// \brief Guards the queue and _Quit, the thread stops when both the queue is empty and _Quit is set.
+static SDL_mutex* _Lock = NULL;
+static SDL_cond* _Wake = NULL;
+static LoaderNode* _Head = NULL;
+static LoaderNode** _Tail = &_Head;
+static bool _Quit = false;
+
+static int Loader_Thread(void* data) {
+	(void)data;
+	SDL_LockMutex(_Lock);
+	for (;;) {
+		while (_Head == NULL && !_Quit) SDL_CondWait(_Wake, _Lock);
+		LoaderNode* node = _Head;
+		if (node == NULL) break;
+		_Head = node->next;
+		if (_Head == NULL) _Tail = &_Head;
+
+		// The queue is free while the job reads or writes its file
+		SDL_UnlockMutex(_Lock);
+		node->job(node->data);
+		RG_FREE(node);
+		SDL_LockMutex(_Lock);
+	}
+	SDL_UnlockMutex(_Lock);
+	return 0;
+}
+
+/// \brief Starts the thread unless it runs, false if it can't be started.
+static bool Start(void) {
+	SDL_AtomicLock(&_Start_Lock);
+	if (_Thread == NULL) {
+		if (_Lock == NULL) _Lock = SDL_CreateMutex();
+		if (_Wake == NULL) _Wake = SDL_CreateCond();
+		_Quit = false;
+		if (_Lock != NULL && _Wake != NULL) _Thread = SDL_CreateThread(Loader_Thread, "RGUI loader", NULL);
+	}
+	bool started = _Thread != NULL;
+	SDL_AtomicUnlock(&_Start_Lock);
+	return started;
+}
+
+void Loader_Post(LoaderJob job, void* data) {
+	if (!Start()) {
+		job(data);
+		return;
+	}
+
+	LoaderNode* node = RG_MALLOC(AllocOther, sizeof(LoaderNode));
+	if (node == NULL) exit(MALLOC_FAILED);
+	node->job = job;
+	node->data = data;
+	node->next = NULL;
+
+	SDL_LockMutex(_Lock);
+	*_Tail = node;
+	_Tail = &node->next;
+	SDL_CondSignal(_Wake);
+	SDL_UnlockMutex(_Lock);
+}
+
+void Loader_Quit(void) {
+	if (_Thread == NULL) return;
+
+	// The jobs posted meanwhile (eg. a reload writing the pixel cache) are queued and run too
+	SDL_LockMutex(_Lock);
+	_Quit = true;
+	SDL_CondSignal(_Wake);
+	SDL_UnlockMutex(_Lock);
+	SDL_WaitThread(_Thread, NULL);
+
+	SDL_AtomicLock(&_Start_Lock);
+	_Thread = NULL;
+	SDL_AtomicUnlock(&_Start_Lock);
+}
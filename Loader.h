@@ -0,0 +1,22 @@
+#include <SDL.h>
+
+#ifndef LOADER_H
+#define LOADER_H
+
+/// \brief One background thread for the file work which shouldn't block a frame:
+/// the reloads of evicted textures and the writes of the pixel cache.
+///
+/// The jobs run one at a time in the order they were posted, so a burst of them
+/// doesn't start a thread each. The thread is started by the first job.
+
+/// \brief A job of the loader thread, it owns its data.
+typedef void (*LoaderJob)(void* data);
+
+/// \brief Queues the job, runs it on the caller if the thread can't be started.
+void Loader_Post(LoaderJob job, void* data);
+/// \brief Runs the queued jobs and joins the thread, the next job starts it again.
+///
+/// Only from the main thread.
+void Loader_Quit(void);
+
+#endif
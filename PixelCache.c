@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL_image.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "PixelCache.h"
+#include "Loader.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define PIXEL_CACHE_MKDIR(dir) _mkdir(dir)
+#else
+#define PIXEL_CACHE_MKDIR(dir) mkdir((dir), 0755)
+#endif
+
+#define PIXEL_CACHE_MAGIC 0x58504752 /* "RGPX" */
+#define PIXEL_CACHE_VERSION 1
+#define PIXEL_CACHE_FORMAT SDL_PIXELFORMAT_ARGB8888
+/// \brief The length of the stored source path, the same as UIElemTexture.path.
+#define PIXEL_CACHE_PATH 51
+/// \brief The most writes waiting for the loader thread, the misses above that aren't cached this time.
+#define PIXEL_CACHE_MAX_WRITES 16
+
+static char _Dir[200 + 1] = PIXEL_CACHE_DEFAULT_DIR;
+static bool _Enabled = true;
+/// \brief The writes not finished yet.
+static SDL_atomic_t _Pending;
+
+/// \brief What a blob was made from, it's only used if all of it matches.
+typedef struct PixelKey {
+	char path[PIXEL_CACHE_PATH];
+	Sint64 mtime;
+	Sint64 size;
+} PixelKey;
+
+/// \brief A write job of the loader thread, it owns the surface.
+typedef struct PixelWrite {
+	PixelKey key;
+	char file[256];
+	SDL_Surface* surface;
+} PixelWrite;
+
+void PixelCache_SetDir(const char* dir) {
+	_Enabled = dir != NULL && strlen(dir) <= 200;
+	if (_Enabled) strcpy(_Dir, dir);
+}
+
+static bool Make_Key(const char* path, PixelKey* key) {
+	struct stat file_stat;
+	if (strlen(path) >= PIXEL_CACHE_PATH || stat(path, &file_stat) != 0) return false;
+
+	memset(key->path, 0, PIXEL_CACHE_PATH);
+	strcpy(key->path, path);
+	key->mtime = (Sint64)file_stat.st_mtime;
+	key->size = (Sint64)file_stat.st_size;
+	return true;
+}
+/// \brief The blob's file name, FNV-1a of the key.
+static void Blob_Name(const PixelKey* key, char* file) {
+	Uint64 hash = 14695981039346656037ull;
+	const Uint8* bytes = (const Uint8*)key->path;
+	for (size_t i = 0; bytes[i] != '\0'; ++i) hash = (hash ^ bytes[i]) * 1099511628211ull;
+	hash = (hash ^ (Uint64)key->mtime) * 1099511628211ull;
+	hash = (hash ^ (Uint64)key->size) * 1099511628211ull;
+	sprintf(file, "%s/%016llx.px", _Dir, (unsigned long long)hash);
+}
+
+/// \brief Reads a blob into a new surface, NULL if it's missing or doesn't match the key.
+static SDL_Surface* Blob_Read(const char* file, const PixelKey* key) {
+	SDL_RWops* rw = SDL_RWFromFile(file, "rb");
+	if (rw == NULL) return NULL;
+
+	SDL_Surface* surface = NULL;
+	char path[PIXEL_CACHE_PATH];
+	Uint32 magic = SDL_ReadLE32(rw);
+	Uint32 version = SDL_ReadLE32(rw);
+	int w = (int)SDL_ReadLE32(rw);
+	int h = (int)SDL_ReadLE32(rw);
+	int pitch = (int)SDL_ReadLE32(rw);
+	Uint32 format = SDL_ReadLE32(rw);
+	Sint64 mtime = (Sint64)SDL_ReadLE64(rw);
+	Sint64 size = (Sint64)SDL_ReadLE64(rw);
+
+	if (magic == PIXEL_CACHE_MAGIC && version == PIXEL_CACHE_VERSION && format == PIXEL_CACHE_FORMAT &&
+		mtime == key->mtime && size == key->size && w > 0 && h > 0 && pitch == w * 4 &&
+		SDL_RWread(rw, path, PIXEL_CACHE_PATH, 1) == 1 && memcmp(path, key->path, PIXEL_CACHE_PATH) == 0) {
+		surface = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, PIXEL_CACHE_FORMAT);
+	}
+
+	// The rows are read straight into the surface, its pitch can be padded
+	if (surface != NULL) {
+		Uint8* pixels = surface->pixels;
+		bool contiguous = surface->pitch == pitch;
+		bool ok = contiguous
+			? SDL_RWread(rw, pixels, (size_t)pitch * h, 1) == 1
+			: true;
+		for (int y = 0; !contiguous && ok && y < h; ++y) {
+			ok = SDL_RWread(rw, pixels + (size_t)y * surface->pitch, pitch, 1) == 1;
+		}
+		if (!ok) {
+			SDL_FreeSurface(surface);
+			surface = NULL;
+		}
+	}
+
+	SDL_RWclose(rw);
+	return surface;
+}
+
+/// \brief Writes the blob next to its place and renames it, readers never see a partial one.
+static void Blob_Write(void* data) {
+	PixelWrite* job = data;
+	SDL_Surface* surface = job->surface;
+	char temp[256 + 16];
+	sprintf(temp, "%s.%lu.tmp", job->file, SDL_ThreadID());
+
+	SDL_RWops* rw = SDL_RWFromFile(temp, "wb");
+	if (rw != NULL) {
+		int pitch = surface->w * 4;
+		bool ok = SDL_WriteLE32(rw, PIXEL_CACHE_MAGIC) && SDL_WriteLE32(rw, PIXEL_CACHE_VERSION) &&
+			SDL_WriteLE32(rw, surface->w) && SDL_WriteLE32(rw, surface->h) &&
+			SDL_WriteLE32(rw, pitch) && SDL_WriteLE32(rw, PIXEL_CACHE_FORMAT) &&
+			SDL_WriteLE64(rw, (Uint64)job->key.mtime) && SDL_WriteLE64(rw, (Uint64)job->key.size) &&
+			SDL_RWwrite(rw, job->key.path, PIXEL_CACHE_PATH, 1) == 1;
+		for (int y = 0; ok && y < surface->h; ++y) {
+			ok = SDL_RWwrite(rw, (Uint8*)surface->pixels + (size_t)y * surface->pitch, pitch, 1) == 1;
+		}
+		SDL_RWclose(rw);
+
+		// Another process may have written the same blob, either one is fine
+		remove(job->file);
+		if (!ok || rename(temp, job->file) != 0) remove(temp);
+	}
+
+	SDL_FreeSurface(surface);
+	RG_FREE(job);
+	SDL_AtomicAdd(&_Pending, -1);
+}
+
+/// \brief Hands a copy of the pixels to the loader thread.
+static void Blob_WriteLater(const PixelKey* key, const char* file, SDL_Surface* surface) {
+	// The image is cached at a later miss, the copies waiting for the disk are bounded
+	if (SDL_AtomicGet(&_Pending) >= PIXEL_CACHE_MAX_WRITES) return;
+
+	PixelWrite* job = RG_MALLOC(AllocTextures, sizeof(PixelWrite));
+	if (job == NULL) exit(MALLOC_FAILED);
+	job->key = *key;
+	strcpy(job->file, file);
+	job->surface = SDL_DuplicateSurface(surface);
+	if (job->surface == NULL) {
+		RG_FREE(job);
+		return;
+	}
+
+	PIXEL_CACHE_MKDIR(_Dir);
+	SDL_AtomicIncRef(&_Pending);
+	Loader_Post(Blob_Write, job);
+}
+
+SDL_Surface* PixelCache_Load(const char* path) {
+	PixelKey key;
+	char file[256];
+	bool cached = _Enabled && Make_Key(path, &key);
+	if (cached) {
+		Blob_Name(&key, file);
+		SDL_Surface* surface = Blob_Read(file, &key);
+		if (surface != NULL) return surface;
+	}
+
+	SDL_Surface* decoded = IMG_Load(path);
+	if (decoded == NULL) return NULL;
+	SDL_Surface* surface = SDL_ConvertSurfaceFormat(decoded, PIXEL_CACHE_FORMAT, 0);
+	SDL_FreeSurface(decoded);
+
+	if (surface != NULL && cached) Blob_WriteLater(&key, file, surface);
+	return surface;
+}
+
+SDL_Texture* PixelCache_Upload(SDL_Renderer* renderer, SDL_Surface* surface) {
+	Uint32 format = surface->format->format;
+	SDL_Texture* tex = SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STATIC, surface->w, surface->h);
+	if (tex == NULL) return NULL;
+	if (SDL_UpdateTexture(tex, NULL, surface->pixels, surface->pitch) != 0) {
+		SDL_DestroyTexture(tex);
+		return NULL;
+	}
+	// Like IMG_LoadTexture does for images with alpha
+	SDL_SetTextureBlendMode(tex, SDL_ISPIXELFORMAT_ALPHA(format) ? SDL_BLENDMODE_BLEND : SDL_BLENDMODE_NONE);
+	return tex;
+}
+
+void PixelCache_Wait(void) {
+	while (SDL_AtomicGet(&_Pending) > 0) SDL_Delay(1);
+}
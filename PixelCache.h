@@ -0,0 +1,31 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#ifndef PIXEL_CACHE_H
+#define PIXEL_CACHE_H
+
+/// \brief A directory of decoded images, so the textures load without decoding the files.
+///
+/// A blob is a fixed header (magic, version, width, height, pitch, pixel format,
+/// the mtime, size and path of the source) followed by the raw ARGB8888 rows,
+/// named after the hash of the source's path, mtime and size.
+/// A changed source gets a new name, a blob whose header doesn't match is ignored.
+/// Misses are decoded as usual and written to the cache by the loader thread (see Loader.h).
+
+/// \brief The default directory, relative to the working directory.
+#define PIXEL_CACHE_DEFAULT_DIR "rgui_cache"
+
+/// \brief Sets the cache directory (max 200 characters), NULL disables the cache.
+void PixelCache_SetDir(const char* dir);
+/// \brief The pixels of the image in SDL_PIXELFORMAT_ARGB8888, from the cache if it has them.
+///
+/// \return The surface to free with SDL_FreeSurface, NULL if the image can't be loaded.
+SDL_Surface* PixelCache_Load(const char* path);
+/// \brief Creates a static texture in the surface's format with SDL_UpdateTexture.
+///
+/// Blended only if the format has alpha, otherwise the blits are straight copies.
+SDL_Texture* PixelCache_Upload(SDL_Renderer* renderer, SDL_Surface* surface);
+/// \brief Waits for the background writes, before exiting.
+void PixelCache_Wait(void);
+
+#endif
@@ -1,8 +1,15 @@
 #include <math.h>
-#include <debugmalloc.h>
-#include <debugmalloc-impl.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <SDL_ttf.h>
 
+#include "Alloc.h"
 #include "RGUI.h"
+#include "Trace.h"
+#include "TickPool.h"
+#include "PixelCache.h"
+#include "Loader.h"
+#include "Text.h"
 
 typedef struct RGWindowNode {
 	RGWindow* rg_window;
@@ -11,6 +18,192 @@ typedef struct RGWindowNode {
 
 static RGWindowNode* RGWindowList = NULL;
 
+static Uint32 Name_Hash(const char* name) {
+	// FNV-1a
+	Uint32 hash = 2166136261u;
+	while (*name != '\0') {
+		hash ^= (Uint8)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/* Registries */
+
+/// \brief The number of slots of a registry, at most half of them are used.
+#define RGUI_REGISTRY_SLOTS 256
+
+/// \brief Builders and callbacks have the same signature, so they share the registry code.
+typedef void (*RGFunction)(UIElem*);
+
+typedef struct RGRegistryEntry {
+	char name[31 + 1];
+	RGFunction function;
+} RGRegistryEntry;
+
+/// \brief Open addressing hash table of names resolved while parsing.
+typedef struct RGRegistry {
+	RGRegistryEntry entries[RGUI_REGISTRY_SLOTS];
+	int count;
+	/// \brief The lines of a file mostly repeat the names of the previous line,
+	/// so the last resolved entry is checked before the table.
+	RGRegistryEntry* last;
+} RGRegistry;
+
+/// \brief The builders by RGML type.
+static RGRegistry _Types = { 0 };
+/// \brief The event callbacks by the names used in the on: fields.
+static RGRegistry _Handlers = { 0 };
+
+static void Registry_Put(RGRegistry* registry, char* name, RGFunction function) {
+	if (strlen(name) > 31) exit(INVALID_RGML);
+
+	size_t i = Name_Hash(name) & (RGUI_REGISTRY_SLOTS - 1);
+	while (registry->entries[i].name[0] != '\0' && strcmp(registry->entries[i].name, name) != 0) {
+		i = (i + 1) & (RGUI_REGISTRY_SLOTS - 1);
+	}
+	if (registry->entries[i].name[0] == '\0') {
+		if (registry->count == RGUI_REGISTRY_SLOTS / 2) {
+			SDL_Log("Can't register \"%s\", the registry is full (RGUI_REGISTRY_SLOTS)\n", name);
+			exit(REGISTRY_FULL);
+		}
+		++registry->count;
+		strcpy(registry->entries[i].name, name);
+	}
+	registry->entries[i].function = function;
+}
+
+/// \brief The entry of a name, NULL if it isn't registered.
+static RGRegistryEntry* Registry_Find(RGRegistry* registry, char* name) {
+	if (registry->last != NULL && strcmp(registry->last->name, name) == 0) return registry->last;
+
+	size_t i = Name_Hash(name) & (RGUI_REGISTRY_SLOTS - 1);
+	for (; registry->entries[i].name[0] != '\0'; i = (i + 1) & (RGUI_REGISTRY_SLOTS - 1)) {
+		if (strcmp(registry->entries[i].name, name) == 0) {
+			return registry->last = &registry->entries[i];
+		}
+	}
+	return NULL;
+}
+
+void RGUI_RegisterType(char* type, UIElem_Builder builder) {
+	Registry_Put(&_Types, type, builder);
+}
+void RGUI_RegisterHandler(char* name, UIElem_EventCallback callback) {
+	Registry_Put(&_Handlers, name, callback);
+}
+
+/// \brief The event names of the on: fields, in the order of EventType.
+static const char* _Event_Names[N_CALLBACKS] = {
+	"enter", "leave", "hover", "lmbdown", "lmbup", "scroll", "drag", "drop", "tick"
+};
+
+/// \brief Attaches the handlers of the on: fields, eg. "on:enter=Highlight on:lmbup=Exit".
+///
+/// \return	0, or the code of the error, which is described in reason.
+static int Bind_Handlers(UIElem* uie, char* handlers, char* reason, size_t size) {
+	for (char* binding = strtok(handlers, " "); binding != NULL; binding = strtok(NULL, " ")) {
+		char* equals = strchr(binding, '=');
+		if (strncmp(binding, "on:", 3) != 0 || equals == NULL) {
+			SDL_snprintf(reason, size, "invalid handler field \"%s\"", binding);
+			return INVALID_RGML;
+		}
+		*equals = '\0';
+
+		int evt = 0;
+		while (evt < N_CALLBACKS && strcmp(_Event_Names[evt], binding + 3) != 0) ++evt;
+		if (evt == N_CALLBACKS) {
+			SDL_snprintf(reason, size, "unknown event \"%s\" of \"%s\"", binding + 3, uie->name);
+			return INVALID_RGML;
+		}
+
+		RGRegistryEntry* handler = Registry_Find(&_Handlers, equals + 1);
+		if (handler == NULL) {
+			SDL_snprintf(reason, size, "unknown handler \"%s\" of \"%s\"", equals + 1, uie->name);
+			return UNKNOWN_HANDLER;
+		}
+		UIElem_AddCallback(uie, uie->name, (EventType)evt, handler->function);
+	}
+	return 0;
+}
+
+/// \brief The templates of the file being parsed.
+///
+/// A template is defined by a line with the type "template" directly under the root,
+/// its name is the type of its instances:
+/// <"template" "card" "0 0 180 180" "255 0 0 255" "card.png"
+/// 	<"button" "close" "150 10 20 20" "0 0 0 255"
+/// <"card" "card1" "10 10"
+/// <"card" "card2" "200 10 180 100" "0 255 0 255"
+/// Instances need only a name and a position, the size, color and texture
+/// are overrides, the rest is shared with the template (see UIElem_Instantiate).
+/// They have no data field, the payloads of the template's builders are copied.
+typedef struct RGTemplateNode {
+	UIElem* elem;
+	struct RGTemplateNode* next;
+} RGTemplateNode;
+
+/// \brief The first error of a parse, the file name and the line are in the message.
+typedef struct RGParseError {
+	/// \brief 0 if there was no error, otherwise an exit code from Error.h.
+	int code;
+	char message[511 + 1];
+} RGParseError;
+
+/// \brief The state of parsing a file, kept between the lines for the progressive loading.
+typedef struct RGParser {
+	FILE* rgml;
+	char* file_name;
+	/// \brief The number of the line being parsed, for the error messages.
+	int line;
+	/// \brief Set by the first error, the parsing stops there.
+	RGParseError error;
+	RGTemplateNode* templates;
+	/// \brief The last parsed element and its depth, the next line is placed relative to it.
+	UIElem* prev;
+	int depth;
+	/// \brief The subtrees are kept out of the tree until they are complete or big enough.
+	bool progressive;
+	/// \brief Progressive: the subtree being parsed, its parent is set but it isn't linked.
+	UIElem* staged;
+	/// \brief Progressive: the number of elements in staged.
+	int staged_count;
+	/// \brief Progressive: the subtrees waiting for RGUI_Render, linked by sibling, the parents come first.
+	UIElem* completed;
+	UIElem** completed_tail;
+	/// \brief Progressive: the closing line was parsed, the parser is freed after the last publishing.
+	bool done;
+	/// \brief Progressive: the task budget of the window before the parsing.
+	Uint32 budget;
+} RGParser;
+
+static UIElem* Find_Template(RGParser* parser, char* type) {
+	for (RGTemplateNode* node = parser->templates; node != NULL; node = node->next) {
+		if (strcmp(node->elem->name, type) == 0) return node->elem;
+	}
+	return NULL;
+}
+/// \brief Removes the templates from the tree, their instances keep the shared parts alive.
+static void Free_Templates(RGParser* parser) {
+	RGTemplateNode* temp;
+	while ((temp = parser->templates) != NULL) {
+		parser->templates = parser->templates->next;
+		// Staged templates were never linked under the root
+		if (parser->progressive) temp->elem->parent = NULL;
+		UIElem_Delete(temp->elem);
+		RG_FREE(temp);
+	}
+}
+
+/// \brief Reads at most max space separated integers, returns how many there were.
+static int Parse_Ints(char* str, int* out, int max) {
+	int count = 0;
+	for (char* token = strtok(str, " "); token != NULL && count < max; token = strtok(NULL, " ")) {
+		out[count++] = SDL_atoi(token);
+	}
+	return count;
+}
+
 typedef enum TagState {
 	Tab,
 	InTag,
@@ -18,15 +211,55 @@ typedef enum TagState {
 	TagEnd
 } TagState;
 
-static UIElem* Make_Node(FILE* rgml, UIElem *prev, int depth) {
+static bool Is_Template(RGParser* parser, UIElem* uie) {
+	for (RGTemplateNode* node = parser->templates; node != NULL; node = node->next) {
+		if (node->elem == uie) return true;
+	}
+	return false;
+}
+/// \brief Queues the subtree being staged for publishing, unless it's a template.
+static void Complete_Staged(RGParser* parser) {
+	UIElem* staged = parser->staged;
+	if (staged == NULL) return;
+	parser->staged = NULL;
+	if (Is_Template(parser, staged)) return;
+
+	// Appended, so the subtrees are published in the order of the file
+	*parser->completed_tail = staged;
+	parser->completed_tail = &staged->sibling;
+}
+
+/// \brief Records the error of the current line, returns false so Make_Node can return it.
+static bool Parse_Error(RGParser* parser, int code, const char* format, ...) {
+	RGParseError* error = &parser->error;
+	int n = SDL_snprintf(error->message, sizeof(error->message), "%s:%d: ", parser->file_name, parser->line);
+	va_list args;
+	va_start(args, format);
+	SDL_vsnprintf(error->message + n, sizeof(error->message) - n, format, args);
+	va_end(args);
+	error->code = code;
+	return false;
+}
+
+/// \brief Parses the next line into a new element.
+///
+/// \return	False after the closing line, or on an error which is recorded in
+///		parser->error; nothing parsed so far is freed then.
+static bool Make_Node(RGParser* parser) {
+	++parser->line;
+	FILE* rgml = parser->rgml;
+	UIElem* prev = parser->prev;
+	int depth = parser->depth;
 	// type, name, dim, color, tex, data
 	char props[6][255 + 1] = { '\0' };
+	// the on: and z: fields can be anywhere after the type, they are collected separately
+	char field[255 + 1], handlers[1023 + 1] = { '\0' };
 
-	int c, prop_index = 0, char_index = 0, new_depth = 0;
+	int c, prop_index = 0, char_index = 0, new_depth = 0, z = 0;
 	TagState state = Tab;
 	bool continue_loop = true;
 	while (continue_loop && (c =  getc(rgml)) != '\n') {
-		if (c == EOF) exit(INVALID_RGML);
+		if (c == EOF) return Parse_Error(parser, INVALID_RGML, "unexpected end of file");
 		switch (state) {
 			case Tab:
 				if (c == '\t') {
@@ -36,9 +269,9 @@ static UIElem* Make_Node(FILE* rgml, UIElem *prev, int depth) {
 				} else if (c == '<') {
 					state = InTag;
 				} else {
-					exit(INVALID_RGML);
+					return Parse_Error(parser, INVALID_RGML, "unexpected '%c' before the tag", c);
 				}
-				if (new_depth - depth > 1) exit(INVALID_RGML);
+				if (new_depth - depth > 1) return Parse_Error(parser, INVALID_RGML, "indented more than one level deeper");
 				break;
 			case InTag:
 				if (c == '"') {
@@ -47,49 +280,54 @@ static UIElem* Make_Node(FILE* rgml, UIElem *prev, int depth) {
 				break;
 			case InProperty:
 				if (c == '"') {
+					field[char_index] = '\0';
+					if (strncmp(field, "on:", 3) == 0) {
+						if (strlen(handlers) + strlen(field) + 1 > 1023) return Parse_Error(parser, INVALID_RGML, "too many handlers");
+						strcat(handlers, " ");
+						strcat(handlers, field);
+					} else if (strncmp(field, "z:", 2) == 0) {
+						z = SDL_atoi(field + 2);
+					} else {
+						if (prop_index > 5) return Parse_Error(parser, INVALID_RGML, "too many properties");
+						strcpy(props[prop_index++], field);
+					}
 					char_index = 0;
-					++prop_index;
 					state = InTag;
 				} else {
-					if (char_index > 255) exit(INVALID_RGML);
-					props[prop_index][char_index++] = c;
+					if (char_index >= 255) return Parse_Error(parser, INVALID_RGML, "property longer than 255 characters");
+					field[char_index++] = c;
 				}
 				break;
 		}
 	}
+	UIElem* proto = continue_loop ? Find_Template(parser, props[0]) : NULL;
 	if ((
 	props[0][0] == '\0' ||
 	props[1][0] == '\0' ||
 	props[2][0] == '\0' ||
-	props[3][0] == '\0') &&
+	(props[3][0] == '\0' && proto == NULL)) &&
 	continue_loop) {
-		exit(INVALID_RGML);
-	}
-	if (!continue_loop) {
-		while ((prev = prev->parent)->parent != NULL);
-		return prev;
+		return Parse_Error(parser, INVALID_RGML, "missing properties");
 	}
+	if (!continue_loop) return false;
 	// the depth will determine the position in the hierarchy
 	int depth_dir = new_depth - depth;
-	Vec2 pos;
-	Vec2 size;
-	pos.X = SDL_atoi(strtok(props[2], " "));
-	pos.Y = SDL_atoi(strtok(NULL, " "));
-	size.X = SDL_atoi(strtok(NULL, " "));
-	size.Y = SDL_atoi(strtok(NULL, " "));
-	Uint8 r, g, b, a;
-	r = SDL_atoi(strtok(props[3], " "));
-	g = SDL_atoi(strtok(NULL, " "));
-	b = SDL_atoi(strtok(NULL, " "));
-	a = SDL_atoi(strtok(NULL, " "));
-	Uint32 color = (r << 24 | g << 16 | b << 8 | a);
-
-	UIElem* new_elem = UIElem_Init(pos, size, props[4], color, props[1]);
+	int dim[4], rgba[4];
+	int n_dim = Parse_Ints(props[2], dim, 4);
+	int n_rgba = Parse_Ints(props[3], rgba, 4);
+	if (n_dim < (proto != NULL ? 2 : 4) || (n_rgba < 4 && (proto == NULL || n_rgba > 0))) {
+		return Parse_Error(parser, INVALID_RGML, "invalid dimensions or color of \"%s\"", props[1]);
+	}
+	// The builder isn't run again on an instance, it gets a copy of the template's payload
+	if (proto != NULL && props[5][0] != '\0') return Parse_Error(parser, INVALID_RGML, "instance \"%s\" with data", props[1]);
+	bool is_template = strcmp(props[0], "template") == 0;
+	if (is_template && new_depth != 1) return Parse_Error(parser, INVALID_RGML, "template \"%s\" not directly under the root", props[1]);
+
 	// HIERARCHY LEGO
+	UIElem* parent;
 	if (depth_dir == 1) {
 		// if 1 it is a child
-		if (prev != NULL) UIElem_AddChild(prev, new_elem);
-		else new_elem->parent = NULL;
+		parent = prev;
 	} else {
 		// if 0 the prev has a new sibling
 		// if -n it is the sibling of the n-th parent of the prev
@@ -97,23 +335,223 @@ static UIElem* Make_Node(FILE* rgml, UIElem *prev, int depth) {
 		for (int i = 0; i < depth_dir; ++i) {
 			prev = prev->parent;
 		}
-		UIElem_AddChild(prev->parent, new_elem);
+		parent = prev->parent;
+	}
+	if (parent == NULL && parser->prev != NULL) return Parse_Error(parser, INVALID_RGML, "second root \"%s\"", props[1]);
+
+	Vec2 pos = { dim[0], dim[1] };
+	Uint32 color = ((Uint8)rgba[0] << 24 | (Uint8)rgba[1] << 16 | (Uint8)rgba[2] << 8 | (Uint8)rgba[3]);
+
+	UIElem* new_elem;
+	if (proto != NULL) {
+		// Only the overrides are applied, everything else is shared
+		new_elem = UIElem_Instantiate(proto, pos, props[1]);
+		if (n_dim == 4) new_elem->size = (Vec2){ dim[2], dim[3] };
+		if (n_rgba == 4) new_elem->color = color;
+		if (props[4][0] != '\0') UIElem_SetTexturePath(new_elem, props[4]);
+	} else {
+		new_elem = UIElem_Init(pos, (Vec2){ dim[2], dim[3] }, props[4], color, props[1]);
 	}
-	return Make_Node(rgml, new_elem, new_depth);
+	new_elem->from_rgml = true;
+	new_elem->file_color = new_elem->color;
+	// Set before linking, so it's put into its place in the paint order
+	new_elem->z = z;
+
+	// The data is handed to the builder as a string, which replaces it with its own payload
+	if (props[5][0] != '\0') {
+		new_elem->data = RG_MALLOC(AllocTree, strlen(props[5]) + 1);
+		if (new_elem->data == NULL) exit(MALLOC_FAILED);
+		strcpy(new_elem->data, props[5]);
+	}
+	RGRegistryEntry* type = proto == NULL ? Registry_Find(&_Types, props[0]) : NULL;
+	if (type != NULL) type->function(new_elem);
+	char reason[255 + 1];
+	int code = Bind_Handlers(new_elem, handlers, reason, sizeof(reason));
+	if (code != 0) {
+		UIElem_Delete(new_elem);
+		return Parse_Error(parser, code, "%s", reason);
+	}
+
+	if (is_template) {
+		RGTemplateNode* template_node = RG_MALLOC(AllocParser, sizeof(RGTemplateNode));
+		if (template_node == NULL) exit(MALLOC_FAILED);
+		template_node->elem = new_elem;
+		template_node->next = parser->templates;
+		parser->templates = template_node;
+	}
+
+	if (parent == NULL) {
+		new_elem->parent = NULL;
+	} else if (parser->progressive && (parser->staged == NULL ||
+		(parent != parser->staged && !UIElem_IsParent(parser->staged, parent)))) {
+		// The parent is published or queued, so the previous subtree is complete, the templates aren't shown
+		Complete_Staged(parser);
+		new_elem->parent = parent;
+		UIElem_Update(new_elem);
+		parser->staged = new_elem;
+		parser->staged_count = 1;
+	} else {
+		UIElem_AddChild(parent, new_elem);
+		// A big subtree is shown with what it has, the rest of it follows in smaller subtrees
+		if (parser->progressive && ++parser->staged_count >= RGUI_PROGRESSIVE_BATCH &&
+			!Is_Template(parser, parser->staged)) Complete_Staged(parser);
+	}
+	parser->prev = new_elem;
+	parser->depth = new_depth;
+	return true;
 }
 
-RGWindow* RGUI_InitWindow(char* file_name) {
-	RGWindow* rg_window = malloc(sizeof(RGWindow));
-	RGWindowNode* window_node = malloc(sizeof(RGWindowNode));
+/// \brief Opens the file and parses the root line.
+///
+/// \return	NULL on an error, which is copied into error.
+static RGParser* Parser_Open(char* file_name, time_t* mtime, bool progressive, RGParseError* error) {
+	RGParser* parser = RG_MALLOC(AllocParser, sizeof(RGParser));
+	if (parser == NULL) exit(MALLOC_FAILED);
+	parser->file_name = file_name;
+	parser->line = 0;
+	parser->error.code = 0;
+	parser->error.message[0] = '\0';
+
+	// The file may be replaced between the two, then it's read at the next check
+	struct stat file_stat;
+	if (stat(file_name, &file_stat) != 0 || (parser->rgml = fopen(file_name, "r")) == NULL) {
+		Parse_Error(parser, FILE_READ_ERROR, "can't be read");
+		*error = parser->error;
+		RG_FREE(parser);
+		return NULL;
+	}
+	*mtime = file_stat.st_mtime;
+	parser->templates = NULL;
+	parser->prev = NULL;
+	parser->depth = -1;
+	parser->progressive = progressive;
+	parser->staged = NULL;
+	parser->staged_count = 0;
+	parser->completed = NULL;
+	parser->completed_tail = &parser->completed;
+	parser->done = false;
+	parser->budget = 0;
+
+	if (!Make_Node(parser)) {
+		if (parser->error.code == 0) Parse_Error(parser, INVALID_RGML, "no root element");
+		*error = parser->error;
+		fclose(parser->rgml);
+		RG_FREE(parser);
+		return NULL;
+	}
+	return parser;
+}
+/// \brief Frees the parser, the subtrees which weren't published are deleted.
+static void Parser_Close(RGParser* parser) {
+	Complete_Staged(parser);
+	Free_Templates(parser);
+	while (parser->completed != NULL) {
+		UIElem* subtree = parser->completed;
+		parser->completed = subtree->sibling;
+		subtree->sibling = NULL;
+		subtree->parent = NULL;
+		UIElem_Delete(subtree);
+	}
+	fclose(parser->rgml);
+	RG_FREE(parser);
+}
+
+/// \brief Parses a whole .rgml file into a new tree.
+///
+/// \return	NULL on an error, which is copied into error; the partial tree is freed.
+static UIElem* Parse_File(char* file_name, time_t* mtime, RGParseError* error) {
+	TRACE_BEGIN(trace_parse);
+	RGParser* parser = Parser_Open(file_name, mtime, false, error);
+	if (parser == NULL) return NULL;
+	UIElem* root_elem = parser->prev;
+	while (Make_Node(parser));
+	*error = parser->error;
+	// The templates are unlinked from the root before it's deleted
+	Parser_Close(parser);
+	if (error->code != 0) {
+		UIElem_Delete(root_elem);
+		root_elem = NULL;
+	}
+	TRACE_END(trace_parse, "RGUI_InitWindow parse", file_name);
+
+	return root_elem;
+}
+
+/// \brief Parses a line in every step, within the task budget of the window.
+static TaskStatus Parse_Task(Task* task) {
+	RGWindow* window = *(RGWindow**)task->data;
+	RGParser* parser = window->parser;
+	TASK_BEGIN(task);
+	while (Make_Node(parser)) TASK_YIELD(task);
+	// The subtrees parsed before an error stay, the window was shown already
+	if (parser->error.code != 0) SDL_Log("%s\n", parser->error.message);
+	Complete_Staged(parser);
+	parser->done = true;
+	TASK_END(task);
+}
+
+/// \brief Links the subtrees parsed since the last frame under their parents, in one batch.
+///
+/// The textures are decoded on the loader thread, so a big subtree doesn't stall the frame.
+static void Publish_Parsed(RGWindow* window) {
+	RGParser* parser = window->parser;
+	if (parser == NULL) return;
+
+	TRACE_BEGIN(trace_publish);
+	while (parser->completed != NULL) {
+		UIElem* subtree = parser->completed;
+		parser->completed = subtree->sibling;
+		subtree->sibling = NULL;
+		// Before linking, so the siblings aren't visited
+		UIElem_LoadTexturesLater(&window->ctx, subtree);
+		UIElem_AddChild(subtree->parent, subtree);
+	}
+	parser->completed_tail = &parser->completed;
+	TRACE_END(trace_publish, "RGUI publish parsed", NULL);
+
+	if (!parser->done) return;
+	window->tasks.budget = parser->budget;
+	Parser_Close(parser);
+	window->parser = NULL;
+	if (window->loaded != NULL) window->loaded(window->ui_root);
+}
+
+/// \brief Creates the window, only after the root line if progressive.
+static RGWindow* Init_Window(char* file_name, bool progressive) {
+	RGWindow* rg_window = RG_MALLOC(AllocTree, sizeof(RGWindow));
+	RGWindowNode* window_node = RG_MALLOC(AllocTree, sizeof(RGWindowNode));
 	if (rg_window == NULL || window_node == NULL) exit(MALLOC_FAILED);
 
 	/*------------------------Init from file-------------------------*/
-	FILE* rgml = fopen(file_name, "r");
-	if (rgml == NULL) exit(FILE_READ_ERROR);
-	UIElem* root_elem = Make_Node(rgml, NULL, -1);
-	fclose(rgml);
-	UIElem_AddCallback(root_elem, root_elem->name, Tick, UIElem_MouseInside);
+	if (strlen(file_name) > 255) exit(FILE_READ_ERROR);
+	strcpy(rg_window->file_name, file_name);
+	rg_window->last_check = SDL_GetTicks();
+	RGParser* parser = NULL;
+	UIElem* root_elem;
+	RGParseError error;
+	if (progressive) {
+		parser = Parser_Open(file_name, &rg_window->file_mtime, true, &error);
+		root_elem = parser != NULL ? parser->prev : NULL;
+	} else {
+		root_elem = Parse_File(file_name, &rg_window->file_mtime, &error);
+	}
+	// Without a tree there is no window
+	if (root_elem == NULL) {
+		SDL_Log("%s\n", error.message);
+		exit(error.code);
+	}
+	rg_window->failed_mtime = 0;
 	rg_window->ui_root = root_elem;
+	rg_window->parser = NULL;
+	rg_window->loaded = NULL;
+	UIContext_Init(&rg_window->ctx, rg_window);
+	TimerWheel_Init(&rg_window->timers, SDL_GetTicks());
+	TaskQueue_Init(&rg_window->tasks);
+	root_elem->ctx = &rg_window->ctx;
+	CommandQueue_Init(&rg_window->commands);
+	Scene_Init(&rg_window->scene);
+	rg_window->render_thread = NULL;
+	rg_window->tick_pool = NULL;
 	/*---------------------------------------------------------------*/
 
 	
@@ -149,26 +587,447 @@ RGWindow* RGUI_InitWindow(char* file_name) {
 	window_node->next = RGWindowList;
 	RGWindowList = window_node;
 
-	RGUI_Current_Window = rg_window;
-	UIElem_LoadTextures(rg_window->ui_root);
+	TRACE_BEGIN(trace_textures);
+	UIElem_LoadTextures(&rg_window->ctx, rg_window->ui_root);
+	TRACE_END(trace_textures, "UIElem_LoadTextures", NULL);
 
+	if (parser != NULL) {
+		rg_window->parser = parser;
+		parser->budget = rg_window->tasks.budget;
+		rg_window->tasks.budget = RGUI_PROGRESSIVE_BUDGET;
+		Task* task = Task_Start(root_elem, Parse_Task, 0, sizeof(RGWindow*));
+		*(RGWindow**)task->data = rg_window;
+	}
 	return rg_window;
 }
+RGWindow* RGUI_InitWindow(char* file_name) {
+	return Init_Window(file_name, false);
+}
+RGWindow* RGUI_InitWindowProgressive(char* file_name) {
+	return Init_Window(file_name, true);
+}
+
+RGWindow* RGUI_WindowOf(const SDL_Event* event) {
+	switch (event->type) {
+	case SDL_MOUSEMOTION:
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+	case SDL_MOUSEWHEEL:
+	case SDL_WINDOWEVENT:
+		break;
+	default:
+		return NULL;
+	}
+	// The windowID is at the same place in every one of these
+	SDL_Window* sdl_window = SDL_GetWindowFromID(event->window.windowID);
+	for (RGWindowNode* node = RGWindowList; node != NULL; node = node->next) {
+		if (node->rg_window->window == sdl_window) return node->rg_window;
+	}
+	return NULL;
+}
 
 void RGUI_Free(void) {
 	RGWindowNode* temp;
 	while ((temp = RGWindowList) != NULL) {
 		RGWindowList = RGWindowList->next;
+		RGUI_StopRenderThread(temp->rg_window);
+		// Its task is cancelled with the root
+		if (temp->rg_window->parser != NULL) Parser_Close(temp->rg_window->parser);
+		TickPool_Destroy(temp->rg_window->tick_pool);
+		CommandQueue_Free(&temp->rg_window->commands);
 		UIElem_Delete(temp->rg_window->ui_root);
+		UIContext_Free(&temp->rg_window->ctx);
+		TimerWheel_Free(&temp->rg_window->timers);
+		TaskQueue_Free(&temp->rg_window->tasks);
+		Scene_Free(&temp->rg_window->scene);
 		SDL_FreeSurface(temp->rg_window->surface);
 		SDL_DestroyRenderer(temp->rg_window->renderer);
 		SDL_DestroyWindow(temp->rg_window->window);
-		free(temp->rg_window);
-		free(temp);
+		RG_FREE(temp->rg_window);
+		RG_FREE(temp);
+	}
+	// The fonts were closed with the atlases of the windows
+	if (TTF_WasInit()) TTF_Quit();
+	PixelCache_Wait();
+	Loader_Quit();
+}
+
+/* Render thread */
+
+/// \brief A texture waiting for the render thread to finish the scenes which could use it.
+typedef struct DeadTexture {
+	SDL_Texture* tex;
+	/// \brief The logic frame being recorded when the texture died, it can be in that scene.
+	int frame;
+	struct DeadTexture* next;
+} DeadTexture;
+
+typedef struct RenderThread {
+	RGWindow* window;
+	SDL_Thread* thread;
+	/// \brief Held while rendering and by every other use of the renderer.
+	SDL_mutex* lock;
+	/// \brief Posted when a scene is published.
+	SDL_sem* frame_ready;
+	SDL_atomic_t quit;
+	/// \brief The frame of the last scene the render thread took, it never goes back to older ones.
+	SDL_atomic_t rendered_frame;
+	SceneBuffer scenes;
+	/// \brief The frame RGUI_Render records next, only used by the logic thread.
+	int frame;
+	DeadTexture* dead;
+} RenderThread;
+
+static int Render_Thread(void* data) {
+	RenderThread* rt = data;
+
+	while (!SDL_AtomicGet(&rt->quit)) {
+		SDL_SemWaitTimeout(rt->frame_ready, 100);
+		Scene* scene = SceneBuffer_Acquire(&rt->scenes);
+		if (scene == NULL) continue;
+
+		SDL_LockMutex(rt->lock);
+		SDL_AtomicSet(&rt->rendered_frame, (int)scene->frame);
+		TRACE_BEGIN(trace_render);
+		Scene_Render(scene, rt->window->renderer, rt->window->surface);
+		TRACE_END(trace_render, "Scene_Render", NULL);
+		TRACE_BEGIN(trace_present);
+		SDL_RenderPresent(rt->window->renderer);
+		TRACE_END(trace_present, "Present", NULL);
+		SDL_UnlockMutex(rt->lock);
+
+		Latency_Record(scene->input_stamps, scene->n_input_stamps);
+		scene->n_input_stamps = 0;
+	}
+	return 0;
+}
+
+/// \brief Destroys the textures no scene can use anymore.
+///
+/// \param all	After the render thread stopped, everything can go.
+static void Sweep_Dead_Textures(RenderThread* rt, bool all) {
+	if (rt->dead == NULL) return;
+	// The logic thread shouldn't wait for a frame to be rendered, it tries again later
+	if (!all && SDL_TryLockMutex(rt->lock) != 0) return;
+
+	// Under the lock the render thread isn't using any scene older than this
+	int rendered = SDL_AtomicGet(&rt->rendered_frame);
+	DeadTexture** link = &rt->dead;
+	while (*link != NULL) {
+		DeadTexture* dead = *link;
+		if (all || rendered > dead->frame) {
+			SDL_DestroyTexture(dead->tex);
+			*link = dead->next;
+			RG_FREE(dead);
+		} else {
+			link = &dead->next;
+		}
+	}
+
+	if (!all) SDL_UnlockMutex(rt->lock);
+}
+
+void RGUI_StartRenderThread(RGWindow* window) {
+	if (window->render_thread != NULL) return;
+
+	RenderThread* rt = RG_MALLOC(AllocOther, sizeof(RenderThread));
+	if (rt == NULL) exit(MALLOC_FAILED);
+	rt->window = window;
+	rt->lock = SDL_CreateMutex();
+	rt->frame_ready = SDL_CreateSemaphore(0);
+	if (rt->lock == NULL || rt->frame_ready == NULL) exit(INIT_FAILED);
+	SDL_AtomicSet(&rt->quit, 0);
+	SDL_AtomicSet(&rt->rendered_frame, -1);
+	SceneBuffer_Init(&rt->scenes);
+	rt->frame = 0;
+	rt->dead = NULL;
+
+	window->render_thread = rt;
+	rt->thread = SDL_CreateThread(Render_Thread, "RGUI render", rt);
+	if (rt->thread == NULL) {
+		SDL_Log("Render thread could not be created! SDL_Error: %s\n", SDL_GetError());
+		exit(INIT_FAILED);
 	}
 }
 
+void RGUI_StopRenderThread(RGWindow* window) {
+	RenderThread* rt = window->render_thread;
+	if (rt == NULL) return;
+
+	SDL_AtomicSet(&rt->quit, 1);
+	SDL_SemPost(rt->frame_ready);
+	SDL_WaitThread(rt->thread, NULL);
+	window->render_thread = NULL;
+
+	Sweep_Dead_Textures(rt, true);
+	SceneBuffer_Free(&rt->scenes);
+	SDL_DestroySemaphore(rt->frame_ready);
+	SDL_DestroyMutex(rt->lock);
+	RG_FREE(rt);
+}
+
+void RGUI_LockRenderer(RGWindow* window) {
+	if (window != NULL && window->render_thread != NULL) SDL_LockMutex(window->render_thread->lock);
+}
+void RGUI_UnlockRenderer(RGWindow* window) {
+	if (window != NULL && window->render_thread != NULL) SDL_UnlockMutex(window->render_thread->lock);
+}
+
+void RGUI_DestroyTexture(RGWindow* window, SDL_Texture* tex) {
+	if (window == NULL || window->render_thread == NULL) {
+		SDL_DestroyTexture(tex);
+		return;
+	}
+
+	DeadTexture* dead = RG_MALLOC(AllocTextures, sizeof(DeadTexture));
+	if (dead == NULL) exit(MALLOC_FAILED);
+	dead->tex = tex;
+	dead->frame = window->render_thread->frame;
+	dead->next = window->render_thread->dead;
+	window->render_thread->dead = dead;
+}
+
 void RGUI_Render(RGWindow* window) {
-	RGUI_Current_Window = window;
-	UIElem_Draw(window->ui_root);
+	CommandQueue_Apply(&window->commands, &window->ctx);
+	UIContext_FinishLoads(&window->ctx);
+	TimerWheel_Advance(&window->timers, SDL_GetTicks());
+	TRACE_BEGIN(trace_tasks);
+	TaskQueue_Run(&window->tasks);
+	TRACE_END(trace_tasks, "TaskQueue_Run", NULL);
+	Publish_Parsed(window);
+
+	RenderThread* rt = window->render_thread;
+	Scene* scene = rt != NULL ? SceneBuffer_Back(&rt->scenes) : &window->scene;
+	Scene_Clear(scene);
+
+	UIElem_MouseInside(&window->ctx, window->ui_root);
+
+	TRACE_BEGIN(trace_tick);
+	TickPool_Run(window->tick_pool, window->ui_root);
+	TRACE_END(trace_tick, "TickPool_Run", NULL);
+
+	TRACE_BEGIN(trace_draw);
+	++window->ctx.frame;
+	UIElem_Draw(window->ui_root, scene);
+	Text_Flush(&window->ctx);
+	UIContext_Evict(&window->ctx);
+	TRACE_END(trace_draw, "UIElem_Draw", NULL);
+
+	if (rt == NULL) {
+		TRACE_BEGIN(trace_render);
+		Scene_Render(scene, window->renderer, window->surface);
+		TRACE_END(trace_render, "Scene_Render", NULL);
+		return;
+	}
+
+	scene->frame = rt->frame++;
+	scene->n_input_stamps += Latency_TakePending(
+		scene->input_stamps + scene->n_input_stamps,
+		SCENE_MAX_INPUT_STAMPS - scene->n_input_stamps
+	);
+	SceneBuffer_Publish(&rt->scenes);
+	SDL_SemPost(rt->frame_ready);
+	Sweep_Dead_Textures(rt, false);
+}
+
+/* Hot reload */
+
+/// \brief Open addressing hash table of the live elements from the file, by name.
+///
+/// Matched elements are only marked as taken, so the ones left untaken
+/// at the end are exactly the ones missing from the new file.
+typedef struct NameMap {
+	UIElem** elems;
+	bool* taken;
+	size_t mask;
+} NameMap;
+
+static size_t Count_Elems(UIElem* uie) {
+	size_t count = 0;
+	for (; uie != NULL; uie = uie->sibling) count += 1 + Count_Elems(uie->child);
+	return count;
+}
+
+static void NameMap_Put(NameMap* map, UIElem* uie) {
+	size_t i = Name_Hash(uie->name) & map->mask;
+	while (map->elems[i] != NULL) i = (i + 1) & map->mask;
+	map->elems[i] = uie;
+}
+static void NameMap_Fill(NameMap* map, UIElem* uie) {
+	for (; uie != NULL; uie = uie->sibling) {
+		if (uie->from_rgml) NameMap_Put(map, uie);
+		NameMap_Fill(map, uie->child);
+	}
+}
+/// \brief Takes the first untaken element with the name, NULL if there is none.
+static UIElem* NameMap_Take(NameMap* map, const char* name) {
+	for (size_t i = Name_Hash(name) & map->mask; map->elems[i] != NULL; i = (i + 1) & map->mask) {
+		if (!map->taken[i] && strcmp(map->elems[i]->name, name) == 0) {
+			map->taken[i] = true;
+			return map->elems[i];
+		}
+	}
+	return NULL;
+}
+static bool NameMap_IsTaken(NameMap* map, UIElem* uie) {
+	for (size_t i = Name_Hash(uie->name) & map->mask; map->elems[i] != NULL; i = (i + 1) & map->mask) {
+		if (map->elems[i] == uie) return map->taken[i];
+	}
+	return true;
+}
+
+/// \brief Tells whether a callback of the parsed element (an on: field or from its builder) is missing from the live one.
+static bool Callbacks_Missing(UIElem* live, UIElem* parsed) {
+	if (parsed->callbacks == NULL) return false;
+	for (size_t i = 0; i < N_CALLBACK_LISTS; ++i) {
+		for (EvLinkedListNode* node = parsed->callbacks->lists[i]; node != NULL; node = node->next) {
+			EvLinkedListNode* found = live->callbacks != NULL ? live->callbacks->lists[i] : NULL;
+			while (found != NULL && found->callback != node->callback) found = found->next;
+			if (found == NULL) return true;
+		}
+	}
+	return false;
+}
+
+/// \brief Copies the properties from the file into a live element, touching only what changed.
+static void Patch_Elem(UIContext* ctx, UIElem* live, UIElem* parsed) {
+	// Only the change, so a highlight XOR-ed onto the color (eg. a hovered button) stays reversible
+	live->color ^= live->file_color ^ parsed->color;
+	live->file_color = parsed->color;
+	// Bound once, when the element was created
+	if (Callbacks_Missing(live, parsed)) {
+		SDL_Log("Reload: the handlers of \"%s\" changed, rename it to apply them\n", live->name);
+	}
+	if (parsed->data_size != 0 && (parsed->data_size != live->data_size || live->data == NULL ||
+		memcmp(live->data, parsed->data, parsed->data_size) != 0)) {
+		SDL_Log("Reload: the builder payload of \"%s\" differs from the file, rename it to recreate it\n", live->name);
+	}
+	live->size = parsed->size;
+	UIElem_SetZ(live, parsed->z);
+	if (strcmp(UIElem_TexPath(live), UIElem_TexPath(parsed)) != 0) UIElem_SetTexture(ctx, live, UIElem_TexPath(parsed));
+	if (!Vec2_Compare(live->rel_position, parsed->rel_position)) {
+		live->rel_position = parsed->rel_position;
+		UIElem_Update(live);
+	}
+
+	if (live->text != NULL && parsed->text != NULL) {
+		// Laid out again only if the string or the font changed
+		Text_SetFont(live, parsed->text->font, parsed->text->pt_size);
+		Text_Set(live, parsed->text->str);
+		live->text->color = parsed->text->color;
+	} else {
+		// Became a text element or stopped being one
+		Text_Free(live->text);
+		live->text = parsed->text;
+		parsed->text = NULL;
+	}
+}
+
+/// \brief Matches the parsed siblings and their subtrees to live elements under live_parent.
+static void Patch_Children(UIContext* ctx, NameMap* map, UIElem* live_parent, UIElem* parsed) {
+	for (; parsed != NULL; parsed = parsed->sibling) {
+		UIElem* live = NameMap_Take(map, parsed->name);
+
+		if (live == NULL) {
+			live = UIElem_Init(parsed->rel_position, parsed->size, "", parsed->color, parsed->name);
+			live->from_rgml = true;
+			live->z = parsed->z;
+			// The default callbacks, the text and the payload of the builder are taken over
+			live->callbacks = parsed->callbacks;
+			if (live->callbacks != NULL) ++live->callbacks->refs;
+			live->text = parsed->text;
+			parsed->text = NULL;
+			live->data = parsed->data;
+			live->data_size = parsed->data_size;
+			parsed->data = NULL;
+			UIElem_AddChild(live_parent, live);
+			UIElem_SetTexture(ctx, live, UIElem_TexPath(parsed));
+		} else {
+			// The ancestors of live_parent are all patched already, so live can't be one of them
+			if (live->parent != live_parent) {
+				UIElem_RemoveFromParent(live);
+				UIElem_AddChild(live_parent, live);
+			}
+			Patch_Elem(ctx, live, parsed);
+		}
+
+		Patch_Children(ctx, map, live, parsed->child);
+	}
+}
+
+/// \brief Deletes the elements from the file which weren't matched.
+static void Delete_Unmatched(NameMap* map, UIElem* uie) {
+	while (uie != NULL) {
+		UIElem* next = uie->sibling;
+		if (uie->from_rgml && !NameMap_IsTaken(map, uie)) UIElem_Delete(uie);
+		else Delete_Unmatched(map, uie->child);
+		uie = next;
+	}
+}
+
+void RGUI_Reload(RGWindow* window) {
+	if (window->parser != NULL) return;
+	time_t mtime = 0;
+	RGParseError error;
+	UIElem* parsed = Parse_File(window->file_name, &mtime, &error);
+	if (parsed == NULL) {
+		// The mtime isn't updated, so it's parsed again at the next check, eg. after a partial write
+		if (mtime != window->failed_mtime) SDL_Log("Reload failed, the window is kept: %s\n", error.message);
+		window->failed_mtime = mtime;
+		return;
+	}
+	window->file_mtime = mtime;
+	UIElem* root = window->ui_root;
+
+	TRACE_BEGIN(trace_reload);
+	NameMap map;
+	size_t capacity = 16;
+	while (capacity < 2 * Count_Elems(root)) capacity *= 2;
+	map.elems = RG_MALLOC(AllocParser, capacity * sizeof(UIElem*));
+	map.taken = RG_MALLOC(AllocParser, capacity * sizeof(bool));
+	if (map.elems == NULL || map.taken == NULL) exit(MALLOC_FAILED);
+	map.mask = capacity - 1;
+	for (size_t i = 0; i < capacity; ++i) {
+		map.elems[i] = NULL;
+		map.taken[i] = false;
+	}
+	NameMap_Fill(&map, root->child);
+
+	// The root is the window, it's matched even if it got renamed
+	if (strcmp(root->name, parsed->name) != 0) {
+		strcpy(root->name, parsed->name);
+		SDL_SetWindowTitle(window->window, root->name);
+	}
+	if (!Vec2_Compare(root->size, parsed->size)) {
+		RGUI_LockRenderer(window);
+		SDL_SetWindowSize(window->window, parsed->size.X, parsed->size.Y);
+		window->surface = SDL_GetWindowSurface(window->window);
+		RGUI_UnlockRenderer(window);
+	}
+	Patch_Elem(&window->ctx, root, parsed);
+	Patch_Children(&window->ctx, &map, root, parsed->child);
+	Delete_Unmatched(&map, root->child);
+
+	RG_FREE(map.elems);
+	RG_FREE(map.taken);
+	UIElem_Delete(parsed);
+	TRACE_END(trace_reload, "RGUI_Reload patch", window->file_name);
+}
+
+void RGUI_CheckReload(RGWindow* window) {
+	Uint32 now = SDL_GetTicks();
+	if (now - window->last_check < 250) return;
+	window->last_check = now;
+
+	struct stat file_stat;
+	if (stat(window->file_name, &file_stat) != 0) return;
+	if (file_stat.st_mtime != window->file_mtime) RGUI_Reload(window);
+}
+
+void RGUI_Present(RGWindow* window) {
+	if (window->render_thread != NULL) return;
+	TRACE_BEGIN(trace_present);
+	SDL_RenderPresent(window->renderer);
+	TRACE_END(trace_present, "Present", NULL);
+	Latency_Present();
 }
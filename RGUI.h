@@ -1,8 +1,13 @@
 #include <stdio.h>
+#include <time.h>
 #include <SDL.h>
 
 #include "Error.h"
 #include "UIElem.h"
+#include "Latency.h"
+#include "CommandQueue.h"
+#include "Timer.h"
+#include "Task.h"
 
 #ifndef RGUI_H
 #define RGUI_H
@@ -14,15 +19,113 @@ typedef struct RGWindow {
 	SDL_Window* window;
 	SDL_Surface* surface;
 	SDL_Renderer* renderer;
+	/// \brief The .rgml file the window was loaded from.
+	char file_name[255 + 1];
+	/// \brief The modification time of the file at the last (re)load.
+	time_t file_mtime;
+	/// \brief The modification time of the file at the last failed reload, its error is logged once.
+	time_t failed_mtime;
+	/// \brief SDL_GetTicks() of the last RGUI_CheckReload which looked at the file.
+	Uint32 last_check;
+	/// \brief Mutations posted from other threads, applied at the start of RGUI_Render.
+	CommandQueue commands;
+	/// \brief The draw list of the rendering without a render thread.
+	Scene scene;
+	/// \brief NULL if the window is rendered by the thread calling RGUI_Render.
+	struct RenderThread* render_thread;
+	/// \brief Runs the parallel Tick callbacks, NULL runs them serially. Freed by RGUI_Free.
+	struct TickPool* tick_pool;
+	/// \brief The texture cache and the hover state of the window, ui_root->ctx points here.
+	UIContext ctx;
+	/// \brief The timers of the elements, fired at the start of RGUI_Render.
+	TimerWheel timers;
+	/// \brief The long running work of the elements, advanced by RGUI_Render within its budget.
+	TaskQueue tasks;
+	/// \brief The progressive parsing of the file, NULL once the whole file is in the tree.
+	struct RGParser* parser;
+	/// \brief Called with the root when the progressive parsing finished, NULL for none.
+	UIElem_Builder loaded;
 } RGWindow;
-RGWindow* RGUI_Current_Window;
 
+/// \brief The µs of a frame spent on the tasks (the parsing among them) while a window loads progressively.
+#define RGUI_PROGRESSIVE_BUDGET 10000
+/// \brief A subtree with this many elements is shown before it's complete while a window loads progressively.
+#define RGUI_PROGRESSIVE_BATCH 64
+
+/// \brief Registers the builder of an RGML type (the first field of a line), max 31 characters.
+///
+/// While parsing, the builder is called on every new element of the type,
+/// after the data field (if there is one) was copied into UIElem.data as a string.
+/// Registering a type again replaces its builder.
+void RGUI_RegisterType(char* type, UIElem_Builder builder);
+/// \brief Registers a callback under the name the on: fields of RGML refer to it, max 31 characters.
+///
+/// eg. after RGUI_RegisterHandler("Exit", Exit) the line
+/// <"button" "quit" "10 10 180 180" "255 0 0 255" "on:lmbup=Exit"
+/// calls Exit when the button is clicked. The events are
+/// enter, leave, hover, lmbdown, lmbup, scroll, drag, drop and tick.
+/// A name which isn't registered stops the loading with UNKNOWN_HANDLER.
+void RGUI_RegisterHandler(char* name, UIElem_EventCallback callback);
 /// \brief Initializes a Window from a file
 RGWindow* RGUI_InitWindow(char* file_name);
-/// \brief Frees all previously allocated windows
+/// \brief Initializes a Window from the root line of the file, the rest is parsed while it's shown.
+///
+/// The lines are parsed by a task of the root within RGUI_PROGRESSIVE_BUDGET per frame,
+/// the subtrees are linked into the tree by RGUI_Render once they are complete, so a
+/// subtree of less than RGUI_PROGRESSIVE_BATCH elements never shows up half parsed.
+/// A bigger one is linked with its first RGUI_PROGRESSIVE_BATCH elements, its later
+/// children follow as subtrees of their own. The textures are decoded on the loader thread.
+/// The elements of the file can't be looked up before RGUI_Render calls window->loaded.
+RGWindow* RGUI_InitWindowProgressive(char* file_name);
+/// \brief Frees all previously allocated windows, waits for the pixel cache writes and stops the loader thread
 void RGUI_Free(void);
-/// \brief Sets surface global and calls UIElem_Draw on root
+/// \brief Applies the posted commands, fires the timers, runs the tasks, updates the hover state and calls UIElem_Draw on root
+///
+/// With a render thread the recorded scene is only handed over to it.
+/// Touches only the state of the window, so different windows can be rendered on different
+/// threads, as long as the events of a window are dispatched on the thread rendering it.
 void RGUI_Render(RGWindow* window);
+/// \brief The window a mouse or window event happened in, by its windowID.
+///
+/// \return NULL for other events and for windows not created by RGUI.
+RGWindow* RGUI_WindowOf(const SDL_Event* event);
+/// \brief Re-parses the file of the window and patches the differences into the live tree.
+///
+/// The elements are matched by name, the matched ones only get their changed
+/// position, size, color and texture updated, so their callbacks and
+/// unchanged textures are kept. Only the elements missing from the new file
+/// are deleted and only the new ones are created.
+/// Elements added from code (not from the file) are left alone. A color is only
+/// touched if it changed in the file, by the same bits, so a color changed by a
+/// callback (eg. a hovered button's highlight) is kept. The on: fields and the
+/// data (the payload of the builder) are only read when an element is created:
+/// for a matched element their changes are ignored with a warning, rename it to recreate it.
+/// Does nothing while the window is still loading progressively.
+/// If the file doesn't parse, the error is logged and the window is left as it was.
+void RGUI_Reload(RGWindow* window);
+/// \brief Reloads the window if its file changed, looks at the file at most every 250 ms.
+void RGUI_CheckReload(RGWindow* window);
+/// \brief Presents the rendered frame and records the latency of the inputs it shows.
+///
+/// Does nothing with a render thread, it presents by itself.
+void RGUI_Present(RGWindow* window);
+
+/// \brief Renders and presents the window on its own thread from now on.
+///
+/// RGUI_Render (the logic thread) records a scene of the rects, colors and
+/// textures and hands it over through a triple buffer, so a slow callback
+/// never stalls the presenting of the latest scene and rendering never
+/// blocks the logic. The renderer is locked while rendering,
+/// textures are loaded under the same lock and destroyed only
+/// after every scene which could still use them is out of use.
+void RGUI_StartRenderThread(RGWindow* window);
+/// \brief Joins the render thread, RGUI_Render renders on its caller again.
+void RGUI_StopRenderThread(RGWindow* window);
+/// \brief Locks the renderer against the render thread, if the window has one.
+void RGUI_LockRenderer(RGWindow* window);
+void RGUI_UnlockRenderer(RGWindow* window);
+/// \brief Destroys a texture of the window, with a render thread once no scene uses it.
+void RGUI_DestroyTexture(RGWindow* window, SDL_Texture* tex);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <string.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "Replay.h"
+
+#define REPLAY_MAGIC 0x50524752 /* "RGRP" */
+#define REPLAY_VERSION 1
+
+/// \brief The events which matter for the dispatch, everything else isn't recorded.
+typedef enum ReplayKind {
+	ReplayMotion = 0,
+	ReplayButtonDown = 1,
+	ReplayButtonUp = 2,
+	ReplayWheel = 3,
+	ReplayTimer = 4,
+	ReplayQuit = 5,
+	/// \brief The pointer left the window.
+	ReplayLeave = 6
+} ReplayKind;
+
+static SDL_RWops* _Recording = NULL;
+static Uint32 _Record_Start = 0;
+static Uint32 _Record_Last = 0;
+
+static SDL_RWops* _Replay = NULL;
+static Uint32 _Replay_Start = 0;
+static Uint32 _Replay_Time = 0;
+static Uint32 _Replay_Window = 0;
+
+static Uint64* _Frame_Times = NULL;
+static size_t _N_Frames = 0;
+static size_t _Frame_Capacity = 0;
+
+bool Replay_StartRecording(char* file_name) {
+	_Recording = SDL_RWFromFile(file_name, "wb");
+	if (_Recording == NULL) return false;
+
+	SDL_WriteLE32(_Recording, REPLAY_MAGIC);
+	SDL_WriteLE32(_Recording, REPLAY_VERSION);
+	_Record_Start = _Record_Last = SDL_GetTicks();
+	return true;
+}
+
+/// Record layout (little-endian):
+/// Uint32 ms since the previous record, Sint16 mouse x, Sint16 mouse y,
+/// Uint8 mouse buttons, Uint8 kind, Sint16 argument (button or wheel).
+void Replay_Record(const SDL_Event* ev, const UIContext* ctx) {
+	if (_Recording == NULL) return;
+
+	ReplayKind kind;
+	Sint16 arg = 0;
+	switch (ev->type) {
+		case SDL_MOUSEMOTION:		kind = ReplayMotion; break;
+		case SDL_MOUSEBUTTONDOWN:	kind = ReplayButtonDown; arg = ev->button.button; break;
+		case SDL_MOUSEBUTTONUP:		kind = ReplayButtonUp; arg = ev->button.button; break;
+		case SDL_MOUSEWHEEL:		kind = ReplayWheel; arg = (Sint16)ctx->wheel_y; break;
+		case SDL_USEREVENT:			kind = ReplayTimer; break;
+		case SDL_QUIT:				kind = ReplayQuit; break;
+		case SDL_WINDOWEVENT:
+			if (ev->window.event != SDL_WINDOWEVENT_LEAVE) return;
+			kind = ReplayLeave;
+			break;
+		default: return;
+	}
+
+	Uint32 now = SDL_GetTicks();
+	SDL_WriteLE32(_Recording, now - _Record_Last);
+	SDL_WriteLE16(_Recording, (Uint16)(Sint16)ctx->mouse_x);
+	SDL_WriteLE16(_Recording, (Uint16)(Sint16)ctx->mouse_y);
+	SDL_WriteU8(_Recording, (Uint8)ctx->mouse_buttons);
+	SDL_WriteU8(_Recording, (Uint8)kind);
+	SDL_WriteLE16(_Recording, (Uint16)arg);
+	_Record_Last = now;
+}
+
+void Replay_StopRecording(void) {
+	if (_Recording == NULL) return;
+	SDL_RWclose(_Recording);
+	_Recording = NULL;
+}
+
+bool Replay_Open(char* file_name, Uint32 window_id) {
+	_Replay = SDL_RWFromFile(file_name, "rb");
+	if (_Replay == NULL) return false;
+
+	if (SDL_ReadLE32(_Replay) != REPLAY_MAGIC || SDL_ReadLE32(_Replay) != REPLAY_VERSION) {
+		Replay_Close();
+		return false;
+	}
+	_Replay_Start = SDL_GetTicks();
+	_Replay_Time = 0;
+	_Replay_Window = window_id;
+	return true;
+}
+
+bool Replay_Next(SDL_Event* ev, bool max_speed) {
+	if (_Replay == NULL) return false;
+
+	Uint8 record[12];
+	if (SDL_RWread(_Replay, record, sizeof(record), 1) != 1) return false;
+
+	Uint32 dt = record[0] | record[1] << 8 | record[2] << 16 | (Uint32)record[3] << 24;
+	Sint16 x = (Sint16)(record[4] | record[5] << 8);
+	Sint16 y = (Sint16)(record[6] | record[7] << 8);
+	Uint8 btn = record[8];
+	ReplayKind kind = record[9];
+	Sint16 arg = (Sint16)(record[10] | record[11] << 8);
+
+	_Replay_Time += dt;
+	if (!max_speed) {
+		Sint32 wait = (Sint32)(_Replay_Start + _Replay_Time - SDL_GetTicks());
+		if (wait > 0) SDL_Delay(wait);
+	}
+
+	memset(ev, 0, sizeof(SDL_Event));
+	ev->common.timestamp = _Replay_Start + _Replay_Time;
+	switch (kind) {
+		case ReplayMotion:
+			ev->type = SDL_MOUSEMOTION;
+			ev->motion.x = x;
+			ev->motion.y = y;
+			ev->motion.state = btn;
+			break;
+		case ReplayButtonDown:
+		case ReplayButtonUp:
+			ev->type = kind == ReplayButtonDown ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+			ev->button.button = (Uint8)arg;
+			ev->button.state = kind == ReplayButtonDown ? SDL_PRESSED : SDL_RELEASED;
+			ev->button.x = x;
+			ev->button.y = y;
+			break;
+		case ReplayWheel:
+			ev->type = SDL_MOUSEWHEEL;
+			ev->wheel.y = arg;
+			ev->wheel.direction = SDL_MOUSEWHEEL_NORMAL;
+			break;
+		case ReplayTimer:
+			ev->type = SDL_USEREVENT;
+			break;
+		case ReplayQuit:
+			ev->type = SDL_QUIT;
+			break;
+		case ReplayLeave:
+			ev->type = SDL_WINDOWEVENT;
+			ev->window.event = SDL_WINDOWEVENT_LEAVE;
+			break;
+		default:
+			exit(FILE_READ_ERROR);
+	}
+	ev->common.timestamp = SDL_GetTicks();
+	// At the same place in every event of a window
+	ev->window.windowID = _Replay_Window;
+	return true;
+}
+
+void Replay_Close(void) {
+	if (_Replay != NULL) SDL_RWclose(_Replay);
+	_Replay = NULL;
+
+	RG_FREE(_Frame_Times);
+	_Frame_Times = NULL;
+	_N_Frames = _Frame_Capacity = 0;
+}
+
+void Replay_FrameTime(Uint64 ticks) {
+	if (_N_Frames == _Frame_Capacity) {
+		size_t capacity = _Frame_Capacity == 0 ? 1024 : _Frame_Capacity * 2;
+		Uint64* frame_times = RG_MALLOC(AllocOther, capacity * sizeof(Uint64));
+		if (frame_times == NULL) exit(MALLOC_FAILED);
+
+		if (_Frame_Times != NULL) {
+			memcpy(frame_times, _Frame_Times, _N_Frames * sizeof(Uint64));
+			RG_FREE(_Frame_Times);
+		}
+		_Frame_Times = frame_times;
+		_Frame_Capacity = capacity;
+	}
+	_Frame_Times[_N_Frames++] = ticks;
+}
+
+static int Compare_Ticks(const void* a, const void* b) {
+	Uint64 x = *(const Uint64*)a, y = *(const Uint64*)b;
+	return (x > y) - (x < y);
+}
+
+void Replay_Report(FILE* out) {
+	if (_N_Frames == 0) {
+		fprintf(out, "frames 0\n");
+		return;
+	}
+
+	SDL_qsort(_Frame_Times, _N_Frames, sizeof(Uint64), Compare_Ticks);
+
+	double ms_per_tick = 1000.0 / SDL_GetPerformanceFrequency();
+	Uint64 sum = 0;
+	for (size_t i = 0; i < _N_Frames; ++i) sum += _Frame_Times[i];
+
+	fprintf(out, "frames %llu\n", (unsigned long long)_N_Frames);
+	fprintf(out, "min_ms %.3f\n", _Frame_Times[0] * ms_per_tick);
+	fprintf(out, "mean_ms %.3f\n", (double)sum / _N_Frames * ms_per_tick);
+	fprintf(out, "p50_ms %.3f\n", _Frame_Times[(_N_Frames - 1) * 50 / 100] * ms_per_tick);
+	fprintf(out, "p95_ms %.3f\n", _Frame_Times[(_N_Frames - 1) * 95 / 100] * ms_per_tick);
+	fprintf(out, "p99_ms %.3f\n", _Frame_Times[(_N_Frames - 1) * 99 / 100] * ms_per_tick);
+	fprintf(out, "max_ms %.3f\n", _Frame_Times[_N_Frames - 1] * ms_per_tick);
+}
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+/// \brief Deterministic input record and replay.
+///
+/// The recorder writes every dispatched event of a window together with the
+/// pointer state of its context into a compact binary log (12 bytes per event).
+/// The replayer restores the same events into one window, the pointer state
+/// is set by dispatching them, so they go through the same path as the live ones.
+/// The frame times of a replay are collected to be reported as a benchmark.
+
+/// \brief Starts writing the dispatched events into the file.
+///
+/// \return false if the file can't be opened.
+bool Replay_StartRecording(char* file_name);
+/// \brief Appends the event and the pointer state of ctx after it to the recording, if there is one.
+void Replay_Record(const SDL_Event* ev, const UIContext* ctx);
+/// \brief Closes the recording.
+void Replay_StopRecording(void);
+
+/// \brief Opens a recording for replay.
+///
+/// \param window_id	The SDL window ID the replayed events are sent to.
+/// \return false if the file can't be opened or isn't a recording.
+bool Replay_Open(char* file_name, Uint32 window_id);
+/// \brief Restores the event of the next record.
+///
+/// \param max_speed	If false waits until the time of the record relative to Replay_Open.
+/// \return false at the end of the recording.
+bool Replay_Next(SDL_Event* ev, bool max_speed);
+/// \brief Closes the replay and frees the collected frame times.
+void Replay_Close(void);
+
+/// \brief Adds the duration of one frame (in performance counter ticks) to the statistics.
+void Replay_FrameTime(Uint64 ticks);
+/// \brief Prints the number of frames, min, mean, p50, p95, p99 and max frame times in ms.
+void Replay_Report(FILE* out);
+
+#endif
@@ -0,0 +1,129 @@
+#include <math.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "Resample.h"
+
+/// \brief The source pixels and their weights making up one destination pixel along an axis.
+typedef struct Contrib {
+	int first;
+	int count;
+	/// \brief count weights, summing to 1.
+	float* weights;
+} Contrib;
+
+/// \brief The contributions of every destination pixel, weights holds them all.
+static Contrib* Make_Contribs(int src_len, int dst_len, float** weights) {
+	float scale = (float)src_len / dst_len;
+	int max_taps = scale > 1 ? (int)ceilf(scale) + 1 : 2;
+
+	Contrib* contribs = RG_MALLOC(AllocTextures, dst_len * sizeof(Contrib));
+	*weights = RG_MALLOC(AllocTextures, (size_t)dst_len * max_taps * sizeof(float));
+	if (contribs == NULL || *weights == NULL) exit(MALLOC_FAILED);
+
+	for (int i = 0; i < dst_len; ++i) {
+		Contrib* c = &contribs[i];
+		c->weights = *weights + (size_t)i * max_taps;
+		c->count = 0;
+
+		if (scale > 1) {
+			// The part of every source pixel covered by [lo, hi)
+			float lo = i * scale, hi = lo + scale;
+			c->first = (int)floorf(lo);
+			int last = (int)ceilf(hi) - 1;
+			if (last > src_len - 1) last = src_len - 1;
+			for (int s = c->first; s <= last; ++s) {
+				float cover = fminf(hi, s + 1.0f) - fmaxf(lo, (float)s);
+				c->weights[c->count++] = cover / scale;
+			}
+		} else {
+			// Between the two nearest pixel centers, clamped at the edges
+			float x = (i + 0.5f) * scale - 0.5f;
+			int x0 = (int)floorf(x);
+			float f = x - x0;
+			if (x0 < 0) {
+				x0 = 0;
+				f = 0;
+			}
+			if (x0 >= src_len - 1) {
+				x0 = src_len - 1;
+				f = 0;
+			}
+			c->first = x0;
+			c->weights[c->count++] = 1 - f;
+			if (f > 0) c->weights[c->count++] = f;
+		}
+	}
+	return contribs;
+}
+
+SDL_Surface* Resample_Surface(SDL_Surface* src, int w, int h) {
+	if (src->format->format != SDL_PIXELFORMAT_ARGB8888 || w <= 0 || h <= 0) return NULL;
+	SDL_Surface* dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (dst == NULL) return NULL;
+
+	float *x_weights, *y_weights;
+	Contrib* x_contribs = Make_Contribs(src->w, w, &x_weights);
+	Contrib* y_contribs = Make_Contribs(src->h, h, &y_weights);
+	// The rows resized horizontally, premultiplied ARGB
+	float* rows = RG_MALLOC(AllocTextures, (size_t)src->h * w * 4 * sizeof(float));
+	if (rows == NULL) exit(MALLOC_FAILED);
+
+	for (int y = 0; y < src->h; ++y) {
+		Uint32* in = (Uint32*)((Uint8*)src->pixels + (size_t)y * src->pitch);
+		float* out = rows + (size_t)y * w * 4;
+		for (int x = 0; x < w; ++x) {
+			Contrib* c = &x_contribs[x];
+			float acc[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < c->count; ++k) {
+				Uint32 p = in[c->first + k];
+				float a = (p >> 24) / 255.0f;
+				float wa = c->weights[k] * a;
+				acc[0] += c->weights[k] * a;
+				acc[1] += wa * ((p >> 16) & 0xFF);
+				acc[2] += wa * ((p >> 8) & 0xFF);
+				acc[3] += wa * (p & 0xFF);
+			}
+			for (int ch = 0; ch < 4; ++ch) out[x * 4 + ch] = acc[ch];
+		}
+	}
+
+	for (int y = 0; y < h; ++y) {
+		Contrib* c = &y_contribs[y];
+		Uint32* out = (Uint32*)((Uint8*)dst->pixels + (size_t)y * dst->pitch);
+		for (int x = 0; x < w; ++x) {
+			float acc[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < c->count; ++k) {
+				float* in = rows + ((size_t)(c->first + k) * w + x) * 4;
+				for (int ch = 0; ch < 4; ++ch) acc[ch] += c->weights[k] * in[ch];
+			}
+
+			Uint32 a = (Uint32)lroundf(fminf(acc[0], 1.0f) * 255);
+			Uint32 p = a << 24;
+			if (a != 0) {
+				for (int ch = 1; ch < 4; ++ch) {
+					long v = lroundf(acc[ch] / acc[0]);
+					p |= (Uint32)(v < 0 ? 0 : v > 255 ? 255 : v) << (8 * (3 - ch));
+				}
+			}
+			out[x] = p;
+		}
+	}
+
+	RG_FREE(rows);
+	RG_FREE(x_contribs);
+	RG_FREE(x_weights);
+	RG_FREE(y_contribs);
+	RG_FREE(y_weights);
+	return dst;
+}
+
+bool Resample_IsOpaque(SDL_Surface* surface) {
+	for (int y = 0; y < surface->h; ++y) {
+		Uint32* row = (Uint32*)((Uint8*)surface->pixels + (size_t)y * surface->pitch);
+		for (int x = 0; x < surface->w; ++x) {
+			if ((row[x] >> 24) != 0xFF) return false;
+		}
+	}
+	return true;
+}
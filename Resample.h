@@ -0,0 +1,17 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+/// \brief Resizes an ARGB8888 surface to w x h, into a new ARGB8888 surface.
+///
+/// Shrinking averages the covered source pixels (box filter), enlarging
+/// interpolates bilinearly, both in premultiplied alpha so transparent
+/// pixels don't darken the edges. Separable, the rows then the columns.
+/// \return NULL if the memory runs out.
+SDL_Surface* Resample_Surface(SDL_Surface* src, int w, int h);
+/// \brief Tells whether every pixel of an ARGB8888 surface has 255 alpha.
+bool Resample_IsOpaque(SDL_Surface* surface);
+
+#endif
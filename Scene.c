@@ -0,0 +1,152 @@
+#include <string.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "Scene.h"
+
+/// \brief Set in SceneBuffer.middle when a scene was published but not acquired yet.
+#define SCENE_FRESH 4
+/// \brief The deepest nesting of ScenePushClip.
+#define SCENE_MAX_CLIPS 64
+
+void Scene_Init(Scene* scene) {
+	scene->items = NULL;
+	scene->count = 0;
+	scene->capacity = 0;
+	scene->frame = 0;
+	scene->input_stamps = RG_MALLOC(AllocOther, SCENE_MAX_INPUT_STAMPS * sizeof(Uint64));
+	if (scene->input_stamps == NULL) exit(MALLOC_FAILED);
+	scene->n_input_stamps = 0;
+}
+
+void Scene_Free(Scene* scene) {
+	RG_FREE(scene->items);
+	RG_FREE(scene->input_stamps);
+	scene->items = NULL;
+	scene->input_stamps = NULL;
+	scene->count = scene->capacity = 0;
+}
+
+void Scene_Clear(Scene* scene) {
+	scene->count = 0;
+}
+
+/// \brief The next item, growing the array if it's full.
+static SceneItem* Scene_Push(Scene* scene) {
+	if (scene->count == scene->capacity) {
+		size_t capacity = scene->capacity == 0 ? 256 : scene->capacity * 2;
+		SceneItem* items = RG_MALLOC(AllocOther, capacity * sizeof(SceneItem));
+		if (items == NULL) exit(MALLOC_FAILED);
+
+		if (scene->items != NULL) {
+			memcpy(items, scene->items, scene->count * sizeof(SceneItem));
+			RG_FREE(scene->items);
+		}
+		scene->items = items;
+		scene->capacity = capacity;
+	}
+
+	return &scene->items[scene->count++];
+}
+
+void Scene_Add(Scene* scene, SceneOp op, SDL_Rect* rect, Uint32 color, SDL_Texture* tex) {
+	SceneItem* item = Scene_Push(scene);
+	item->op = op;
+	item->rect = *rect;
+	item->color = color;
+	item->tex = tex;
+}
+void Scene_AddCopy(Scene* scene, SDL_Rect* rect, SDL_Rect* src, Uint32 color, SDL_Texture* tex) {
+	SceneItem* item = Scene_Push(scene);
+	item->op = SceneCopy;
+	item->rect = *rect;
+	item->src = *src;
+	item->color = color;
+	item->tex = tex;
+}
+
+/// \brief The surface clip is the source of truth, the renderer always mirrors it.
+static void Set_Clip(SDL_Renderer* renderer, SDL_Surface* surface, SDL_Rect* clip) {
+	SDL_SetClipRect(surface, clip);
+	SDL_RenderSetClipRect(renderer, clip);
+}
+
+void Scene_Render(Scene* scene, SDL_Renderer* renderer, SDL_Surface* surface) {
+	SDL_Rect clips[SCENE_MAX_CLIPS];
+	int n_clips = 0, skipped = 0;
+
+	SDL_RenderClear(renderer);
+	Set_Clip(renderer, surface, NULL);
+	SDL_GetClipRect(surface, &clips[0]);
+
+	for (size_t i = 0; i < scene->count; ++i) {
+		SceneItem* item = &scene->items[i];
+
+		// Everything inside an empty or too deep clip is skipped until its pop
+		if (skipped > 0) {
+			if (item->op == ScenePushClip) ++skipped;
+			else if (item->op == ScenePopClip) --skipped;
+			continue;
+		}
+
+		switch (item->op) {
+			case SceneDraw:
+				if ((0x000000FF & item->color) != 0x00000000) {
+					SDL_FillRect(surface, &item->rect, SDL_MapRGBA(
+						surface->format,
+						item->color >> 24,
+						item->color >> 16,
+						item->color >> 8,
+						item->color
+					));
+				}
+				if (item->tex != NULL) SDL_RenderCopy(renderer, item->tex, NULL, &item->rect);
+				break;
+			case SceneCopy:
+				// The texture is shared (eg. a glyph atlas), so the modulation is set for every copy
+				SDL_SetTextureColorMod(item->tex, item->color >> 24, item->color >> 16, item->color >> 8);
+				SDL_SetTextureAlphaMod(item->tex, item->color);
+				SDL_RenderCopy(renderer, item->tex, &item->src, &item->rect);
+				break;
+			case ScenePushClip:
+				if (n_clips + 1 == SCENE_MAX_CLIPS ||
+					!SDL_IntersectRect(&clips[n_clips], &item->rect, &clips[n_clips + 1])) {
+					skipped = 1;
+					break;
+				}
+				Set_Clip(renderer, surface, &clips[++n_clips]);
+				break;
+			case ScenePopClip:
+				if (n_clips > 0) Set_Clip(renderer, surface, &clips[--n_clips]);
+				break;
+		}
+	}
+	Set_Clip(renderer, surface, NULL);
+}
+
+/* Triple buffer */
+
+void SceneBuffer_Init(SceneBuffer* buffer) {
+	for (int i = 0; i < 3; ++i) Scene_Init(&buffer->scenes[i]);
+	buffer->back = 0;
+	buffer->front = 1;
+	SDL_AtomicSet(&buffer->middle, 2);
+}
+
+void SceneBuffer_Free(SceneBuffer* buffer) {
+	for (int i = 0; i < 3; ++i) Scene_Free(&buffer->scenes[i]);
+}
+
+Scene* SceneBuffer_Back(SceneBuffer* buffer) {
+	return &buffer->scenes[buffer->back];
+}
+
+void SceneBuffer_Publish(SceneBuffer* buffer) {
+	buffer->back = SDL_AtomicSet(&buffer->middle, buffer->back | SCENE_FRESH) & ~SCENE_FRESH;
+}
+
+Scene* SceneBuffer_Acquire(SceneBuffer* buffer) {
+	if (!(SDL_AtomicGet(&buffer->middle) & SCENE_FRESH)) return NULL;
+	buffer->front = SDL_AtomicSet(&buffer->middle, buffer->front) & ~SCENE_FRESH;
+	return &buffer->scenes[buffer->front];
+}
@@ -0,0 +1,85 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#ifndef SCENE_H
+#define SCENE_H
+
+/// \brief What a SceneItem does when rendered.
+typedef enum SceneOp {
+	/// \brief Fills the rect with the color (if its alpha isn't 0), then copies the texture on it.
+	SceneDraw,
+	/// \brief Copies the src rect of the texture 1:1 to the rect, with the color as its color and alpha modulation.
+	SceneCopy,
+	/// \brief Limits the following items to the rect (intersected with the current clip).
+	ScenePushClip,
+	/// \brief Restores the clip before the matching ScenePushClip.
+	ScenePopClip
+} SceneOp;
+
+typedef struct SceneItem {
+	SceneOp op;
+	SDL_Rect rect;
+	/// \brief The part of the texture for SceneCopy.
+	SDL_Rect src;
+	Uint32 color;
+	SDL_Texture* tex;
+} SceneItem;
+
+/// \brief Everything needed to render a frame, recorded by UIElem_Draw.
+///
+/// It doesn't point into the UIElem tree, so it can be rendered
+/// on another thread while the tree changes.
+typedef struct Scene {
+	SceneItem* items;
+	size_t count;
+	size_t capacity;
+	/// \brief The number of the logic frame which recorded the scene.
+	Uint64 frame;
+	/// \brief The input stamps of Latency shown by this frame.
+	///
+	/// Zeroed by the consumer after recording them, so if a scene is skipped
+	/// its stamps are carried over into the next one recorded into it.
+	Uint64* input_stamps;
+	size_t n_input_stamps;
+} Scene;
+
+/// \brief The maximum number of input stamps carried by a scene.
+#define SCENE_MAX_INPUT_STAMPS 256
+
+/// \brief Initializes an empty scene.
+void Scene_Init(Scene* scene);
+/// \brief Frees the items of the scene.
+void Scene_Free(Scene* scene);
+/// \brief Removes every item, keeps the memory and the input stamps.
+void Scene_Clear(Scene* scene);
+/// \brief Appends an item.
+void Scene_Add(Scene* scene, SceneOp op, SDL_Rect* rect, Uint32 color, SDL_Texture* tex);
+/// \brief Appends a SceneCopy item.
+void Scene_AddCopy(Scene* scene, SDL_Rect* rect, SDL_Rect* src, Uint32 color, SDL_Texture* tex);
+/// \brief Clears the renderer and renders every item of the scene (without presenting).
+void Scene_Render(Scene* scene, SDL_Renderer* renderer, SDL_Surface* surface);
+
+/// \brief Triple buffer of scenes between a producer and a consumer thread.
+///
+/// The producer always has a scene to record into and the consumer always
+/// has the latest complete scene, neither of them ever waits for the other.
+typedef struct SceneBuffer {
+	Scene scenes[3];
+	/// \brief Recorded into, owned by the producer.
+	int back;
+	/// \brief Rendered, owned by the consumer.
+	int front;
+	/// \brief The index of the exchanged scene, with SCENE_FRESH set if it wasn't consumed yet.
+	SDL_atomic_t middle;
+} SceneBuffer;
+
+void SceneBuffer_Init(SceneBuffer* buffer);
+void SceneBuffer_Free(SceneBuffer* buffer);
+/// \brief The scene the producer should record into.
+Scene* SceneBuffer_Back(SceneBuffer* buffer);
+/// \brief Hands the recorded back scene to the consumer.
+void SceneBuffer_Publish(SceneBuffer* buffer);
+/// \brief Takes the latest published scene, NULL if nothing new was published.
+Scene* SceneBuffer_Acquire(SceneBuffer* buffer);
+
+#endif
@@ -0,0 +1,147 @@
+#include <string.h>
+
+#include "Alloc.h"
+#include "RGUI.h"
+#include "Task.h"
+
+/// \brief Whether a runs before b.
+static bool Task_Before(Task* a, Task* b) {
+	if (a->deadline != b->deadline) return (Sint32)(a->deadline - b->deadline) < 0;
+	return (Sint32)(a->seq - b->seq) < 0;
+}
+
+static void Heap_Set(TaskQueue* queue, int i, Task* task) {
+	queue->heap[i] = task;
+	task->heap_index = i;
+}
+static void Heap_Up(TaskQueue* queue, int i) {
+	Task* task = queue->heap[i];
+	while (i > 0 && Task_Before(task, queue->heap[(i - 1) / 2])) {
+		Heap_Set(queue, i, queue->heap[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	Heap_Set(queue, i, task);
+}
+static void Heap_Down(TaskQueue* queue, int i) {
+	Task* task = queue->heap[i];
+	while (2 * i + 1 < queue->count) {
+		int child = 2 * i + 1;
+		if (child + 1 < queue->count && Task_Before(queue->heap[child + 1], queue->heap[child])) ++child;
+		if (!Task_Before(queue->heap[child], task)) break;
+		Heap_Set(queue, i, queue->heap[child]);
+		i = child;
+	}
+	Heap_Set(queue, i, task);
+}
+
+static void Heap_Push(TaskQueue* queue, Task* task) {
+	if (queue->count == queue->capacity) {
+		int capacity = queue->capacity == 0 ? 16 : queue->capacity * 2;
+		Task** heap = RG_MALLOC(AllocOther, capacity * sizeof(Task*));
+		if (heap == NULL) exit(MALLOC_FAILED);
+		if (queue->heap != NULL) {
+			memcpy(heap, queue->heap, queue->count * sizeof(Task*));
+			RG_FREE(queue->heap);
+		}
+		queue->heap = heap;
+		queue->capacity = capacity;
+	}
+	task->seq = queue->seq++;
+	queue->heap[queue->count] = task;
+	Heap_Up(queue, queue->count++);
+}
+static void Heap_Remove(TaskQueue* queue, Task* task) {
+	int i = task->heap_index;
+	Task* last = queue->heap[--queue->count];
+	task->heap_index = -1;
+	if (last == task) return;
+
+	Heap_Set(queue, i, last);
+	Heap_Up(queue, i);
+	Heap_Down(queue, last->heap_index);
+}
+
+static void Task_Free(Task* task) {
+	*task->elem_pprev = task->elem_next;
+	if (task->elem_next != NULL) task->elem_next->elem_pprev = task->elem_pprev;
+	RG_FREE(task);
+}
+
+void TaskQueue_Init(TaskQueue* queue) {
+	queue->heap = NULL;
+	queue->count = 0;
+	queue->capacity = 0;
+	queue->seq = 0;
+	queue->budget = TASK_DEFAULT_BUDGET;
+	queue->running = NULL;
+}
+
+void TaskQueue_Free(TaskQueue* queue) {
+	while (queue->count > 0) Task_Cancel(queue->heap[0]);
+	RG_FREE(queue->heap);
+	queue->heap = NULL;
+	queue->capacity = 0;
+}
+
+bool TaskQueue_Run(TaskQueue* queue) {
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 budget = SDL_GetPerformanceFrequency() * queue->budget / 1000000;
+
+	while (queue->count > 0) {
+		Task* task = queue->heap[0];
+		Heap_Remove(queue, task);
+
+		queue->running = task;
+		TaskStatus status = task->func(task);
+		queue->running = NULL;
+
+		if (status == TaskDone || task->cancelled) Task_Free(task);
+		else Heap_Push(queue, task);
+
+		if (SDL_GetPerformanceCounter() - start >= budget) break;
+	}
+	return queue->count > 0;
+}
+
+Task* Task_Start(UIElem* owner, TaskFunc func, Uint32 deadline, size_t data_size) {
+	UIContext* ctx = UIElem_Context(owner);
+	if (ctx == NULL) return NULL;
+
+	Task* task = RG_MALLOC(AllocCallbacks, sizeof(Task) + data_size);
+	if (task == NULL) exit(MALLOC_FAILED);
+	memset(task->data, 0, data_size);
+
+	task->state = 0;
+	task->owner = owner;
+	task->deadline = SDL_GetTicks() + deadline;
+	task->func = func;
+	task->queue = &ctx->window->tasks;
+	task->cancelled = false;
+
+	task->elem_next = owner->tasks;
+	if (owner->tasks != NULL) owner->tasks->elem_pprev = &task->elem_next;
+	task->elem_pprev = &owner->tasks;
+	owner->tasks = task;
+
+	Heap_Push(task->queue, task);
+	return task;
+}
+
+void Task_Cancel(Task* task) {
+	if (task->cancelled) return;
+	if (task->queue->running == task) {
+		// TaskQueue_Run frees it when the function returns, but the owner may be gone by then
+		*task->elem_pprev = task->elem_next;
+		if (task->elem_next != NULL) task->elem_next->elem_pprev = task->elem_pprev;
+		task->elem_next = NULL;
+		task->elem_pprev = &task->elem_next;
+		task->cancelled = true;
+		return;
+	}
+	Heap_Remove(task->queue, task);
+	Task_Free(task);
+}
+
+void Task_CancelAll(UIElem* owner) {
+	while (owner->tasks != NULL) Task_Cancel(owner->tasks);
+}
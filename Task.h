@@ -0,0 +1,92 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef TASK_H
+#define TASK_H
+
+/// \brief The default time a window spends on its tasks in one frame, in µs.
+#define TASK_DEFAULT_BUDGET 4000
+
+typedef enum TaskStatus {
+	/// \brief The task wants to be resumed later.
+	TaskYield,
+	TaskDone
+} TaskStatus;
+
+struct Task;
+/// \brief One step of a task, resumed where it yielded, see TASK_BEGIN.
+typedef TaskStatus (*TaskFunc)(struct Task* task);
+
+/// \brief A resumable piece of work owned by an element, cancelled when it's deleted.
+typedef struct Task {
+	/// \brief Where the function resumes, 0 at the start.
+	int state;
+	UIElem* owner;
+	/// \brief SDL_GetTicks() until the task should be done, the earliest one runs first.
+	Uint32 deadline;
+	TaskFunc func;
+	struct TaskQueue* queue;
+	/// \brief The index in the heap of the queue, -1 while it's running.
+	int heap_index;
+	/// \brief The order of scheduling, tasks with the same deadline take turns.
+	Uint32 seq;
+	/// \brief Cancelled while it was running, freed when it returns.
+	bool cancelled;
+	/// \brief The links in the list of the owner's tasks.
+	struct Task *elem_next, **elem_pprev;
+	/// \brief data_size bytes for the variables living across yields, zeroed.
+	max_align_t data[];
+} Task;
+
+/// \brief The tasks of a window, a min-heap by deadline.
+typedef struct TaskQueue {
+	Task** heap;
+	int count;
+	int capacity;
+	Uint32 seq;
+	/// \brief The µs TaskQueue_Run spends on the tasks.
+	Uint32 budget;
+	/// \brief The task being run, NULL if none is.
+	Task* running;
+} TaskQueue;
+
+/// \brief Initializes an empty queue with TASK_DEFAULT_BUDGET.
+void TaskQueue_Init(TaskQueue* queue);
+/// \brief Frees the tasks left in the queue.
+void TaskQueue_Free(TaskQueue* queue);
+/// \brief Runs the tasks by deadline until the budget is used up, at least one step.
+///
+/// \return true if tasks are left, the event loop shouldn't sleep then.
+bool TaskQueue_Run(TaskQueue* queue);
+
+/// \brief Schedules func on the owner's window, due in deadline ms.
+///
+/// \return The task with data_size zeroed bytes in data, NULL if the owner isn't in a window.
+Task* Task_Start(UIElem* owner, TaskFunc func, Uint32 deadline, size_t data_size);
+/// \brief Stops and frees the task, it can be the running one.
+void Task_Cancel(Task* task);
+/// \brief Cancels every task of the element, UIElem_Delete calls it.
+void Task_CancelAll(UIElem* owner);
+
+/// \brief Stackless coroutines: the body of a TaskFunc goes between TASK_BEGIN and TASK_END.
+///
+/// Local variables don't survive a TASK_YIELD, keep them in task->data.
+/// TASK_YIELD can't be used inside a switch of the body.
+///
+///	TaskStatus Build_Rows(Task* task) {
+///		BuildState* s = (BuildState*)task->data;
+///		TASK_BEGIN(task);
+///		for (s->i = 0; s->i < 10000; ++s->i) {
+///			UIElem_AddChild(task->owner, Make_Row(s->i));
+///			TASK_YIELD(task);
+///		}
+///		TASK_END(task);
+///	}
+#define TASK_BEGIN(task) switch ((task)->state) { case 0:
+#define TASK_YIELD(task) do { (task)->state = __LINE__; return TaskYield; case __LINE__:; } while (0)
+#define TASK_END(task) } return TaskDone
+
+#endif
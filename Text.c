@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <SDL_ttf.h>
+
+#include "Alloc.h"
+#include "RGUI.h"
+#include "Text.h"
+
+/// \brief The height of a new atlas, it doubles when it's full.
+#define TEXT_ATLAS_MIN_HEIGHT 64
+/// \brief The most times an atlas can grow, TEXT_ATLAS_MAX_HEIGHT / TEXT_ATLAS_MIN_HEIGHT = 2^6.
+#define TEXT_MAX_RETIRED 6
+/// \brief The hash buckets of the runs per atlas.
+#define TEXT_RUN_BUCKETS 256
+
+typedef struct Glyph {
+	/// \brief 0 marks an empty slot, glyph 0 isn't rasterized.
+	Uint16 ch;
+	/// \brief The pixels in the atlas, w is 0 if the glyph has none (eg. space).
+	SDL_Rect src;
+	/// \brief Where the pixels start relative to the pen.
+	int offset_x;
+	int advance;
+} Glyph;
+
+/// \brief A glyph of a run, positioned relative to the upper left corner of the element.
+typedef struct TextQuad {
+	SDL_Rect src;
+	int x, y;
+} TextQuad;
+
+/// \brief A laid out string, shared by the elements of a window showing it with the same font.
+typedef struct TextRun {
+	/// \brief Stored after the quads, in the same block.
+	char* str;
+	struct GlyphAtlas* atlas;
+	/// \brief The elements using it, at 0 it's on the unused list of the atlas.
+	int refs;
+	size_t n_quads;
+	struct TextRun* next;
+	struct TextRun *unused_prev, *unused_next;
+	TextQuad quads[];
+} TextRun;
+
+/// \brief A texture replaced by a bigger one, the scene of the frame can still use it.
+typedef struct RetiredAtlas {
+	SDL_Texture* tex;
+	Uint64 frame;
+} RetiredAtlas;
+
+/// \brief The glyphs of a font at one size, rasterized into rows of the line's height.
+typedef struct GlyphAtlas {
+	char font_path[51];
+	int pt_size;
+	/// \brief NULL if the font couldn't be opened, then nothing is drawn with it.
+	TTF_Font* font;
+	UIContext* ctx;
+	int line_height;
+	int line_skip;
+
+	/// \brief Open addressing table of the rasterized glyphs.
+	Glyph* glyphs;
+	size_t glyph_mask;
+	size_t n_glyphs;
+
+	/// \brief The rasterized glyphs, white with the coverage in the alpha.
+	SDL_Surface* pixels;
+	SDL_Texture* tex;
+	RetiredAtlas retired[TEXT_MAX_RETIRED];
+	int n_retired;
+	/// \brief Where the next glyph goes.
+	int pen_x, pen_y;
+	/// \brief The rows changed since the last Text_Flush, none if dirty_top >= dirty_bottom.
+	int dirty_top, dirty_bottom;
+
+	TextRun* runs[TEXT_RUN_BUCKETS];
+	/// \brief The runs with no references, the most recently released first.
+	TextRun *unused_head, *unused_tail;
+	size_t n_unused;
+
+	struct GlyphAtlas* next;
+} GlyphAtlas;
+
+static Uint32 Text_Hash(const char* str) {
+	// FNV-1a
+	Uint32 hash = 2166136261u;
+	while (*str != '\0') {
+		hash ^= (Uint8)*str++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+/// \brief Decodes the next character, invalid bytes become U+FFFD.
+static Uint32 UTF8_Next(const char** str) {
+	const Uint8* s = (const Uint8*)*str;
+	Uint32 ch;
+	int extra;
+
+	if (s[0] < 0x80) { ch = s[0]; extra = 0; }
+	else if ((s[0] & 0xE0) == 0xC0) { ch = s[0] & 0x1F; extra = 1; }
+	else if ((s[0] & 0xF0) == 0xE0) { ch = s[0] & 0x0F; extra = 2; }
+	else if ((s[0] & 0xF8) == 0xF0) { ch = s[0] & 0x07; extra = 3; }
+	else { *str += 1; return 0xFFFD; }
+
+	for (int i = 1; i <= extra; ++i) {
+		if ((s[i] & 0xC0) != 0x80) {
+			*str += i;
+			return 0xFFFD;
+		}
+		ch = ch << 6 | (s[i] & 0x3F);
+	}
+	*str += 1 + extra;
+	return ch;
+}
+
+/* Atlas */
+
+/// \brief Makes a texture for the pixels of the atlas, uploaded by Text_Flush.
+static SDL_Texture* Atlas_Texture(GlyphAtlas* atlas) {
+	RGUI_LockRenderer(atlas->ctx->window);
+	SDL_Texture* tex = SDL_CreateTexture(atlas->ctx->window->renderer, SDL_PIXELFORMAT_ARGB8888,
+		SDL_TEXTUREACCESS_STATIC, atlas->pixels->w, atlas->pixels->h);
+	RGUI_UnlockRenderer(atlas->ctx->window);
+
+	if (tex == NULL) {
+		SDL_Log("Glyph atlas could not be created! SDL_Error: %s\n", SDL_GetError());
+		return NULL;
+	}
+	SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
+	RG_TRACK(AllocTextures, (Sint64)atlas->pixels->h * atlas->pixels->pitch);
+	atlas->dirty_top = 0;
+	atlas->dirty_bottom = atlas->pixels->h;
+	return tex;
+}
+static void Atlas_DestroyTexture(GlyphAtlas* atlas, SDL_Texture* tex) {
+	if (tex == NULL) return;
+	int w, h;
+	SDL_QueryTexture(tex, NULL, NULL, &w, &h);
+	RG_TRACK(AllocTextures, -(Sint64)w * h * 4);
+	RGUI_DestroyTexture(atlas->ctx->window, tex);
+}
+
+/// \brief Doubles the height of the atlas, the glyphs stay where they were.
+static bool Atlas_Grow(GlyphAtlas* atlas) {
+	if (atlas->pixels->h * 2 > TEXT_ATLAS_MAX_HEIGHT || atlas->n_retired == TEXT_MAX_RETIRED) return false;
+
+	SDL_Surface* pixels = SDL_CreateRGBSurfaceWithFormat(0, TEXT_ATLAS_WIDTH, atlas->pixels->h * 2, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (pixels == NULL) exit(MALLOC_FAILED);
+	SDL_SetSurfaceBlendMode(atlas->pixels, SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(atlas->pixels, NULL, pixels, NULL);
+	SDL_FreeSurface(atlas->pixels);
+	atlas->pixels = pixels;
+
+	// The scene of this frame may already use the old texture, it's destroyed by a later Text_Flush
+	if (atlas->tex != NULL) {
+		atlas->retired[atlas->n_retired++] = (RetiredAtlas){ atlas->tex, atlas->ctx->frame };
+	}
+	atlas->tex = Atlas_Texture(atlas);
+	return true;
+}
+
+/// \brief Guards the initialization of SDL_ttf.
+static SDL_SpinLock _TTF_Lock = 0;
+
+static GlyphAtlas* Atlas_Get(UIContext* ctx, char* font_path, int pt_size) {
+	GlyphAtlas* atlas;
+	for (atlas = ctx->atlases; atlas != NULL; atlas = atlas->next) {
+		if (atlas->pt_size == pt_size && strcmp(atlas->font_path, font_path) == 0) return atlas;
+	}
+
+	// The windows may be rendered on different threads
+	SDL_AtomicLock(&_TTF_Lock);
+	if (!TTF_WasInit() && TTF_Init() < 0) {
+		SDL_Log("SDL_ttf could not initialize! TTF_Error: %s\n", TTF_GetError());
+		exit(INIT_FAILED);
+	}
+	SDL_AtomicUnlock(&_TTF_Lock);
+
+	atlas = RG_MALLOC(AllocTextures, sizeof(GlyphAtlas));
+	if (atlas == NULL) exit(MALLOC_FAILED);
+	strcpy(atlas->font_path, font_path);
+	atlas->pt_size = pt_size;
+	atlas->ctx = ctx;
+	atlas->font = TTF_OpenFont(font_path, pt_size);
+	if (atlas->font == NULL) {
+		// Cached like a failed texture, so it isn't retried by every element
+		SDL_Log("Font %s could not be opened! TTF_Error: %s\n", font_path, TTF_GetError());
+	}
+	atlas->line_height = atlas->font != NULL ? TTF_FontHeight(atlas->font) : 0;
+	atlas->line_skip = atlas->font != NULL ? TTF_FontLineSkip(atlas->font) : 0;
+
+	atlas->glyph_mask = 127;
+	atlas->n_glyphs = 0;
+	atlas->glyphs = RG_MALLOC(AllocTextures, (atlas->glyph_mask + 1) * sizeof(Glyph));
+	if (atlas->glyphs == NULL) exit(MALLOC_FAILED);
+	memset(atlas->glyphs, 0, (atlas->glyph_mask + 1) * sizeof(Glyph));
+
+	atlas->pixels = SDL_CreateRGBSurfaceWithFormat(0, TEXT_ATLAS_WIDTH, TEXT_ATLAS_MIN_HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+	if (atlas->pixels == NULL) exit(MALLOC_FAILED);
+	atlas->n_retired = 0;
+	atlas->tex = atlas->font != NULL ? Atlas_Texture(atlas) : NULL;
+	atlas->pen_x = atlas->pen_y = 0;
+	atlas->dirty_top = atlas->dirty_bottom = 0;
+
+	for (int i = 0; i < TEXT_RUN_BUCKETS; ++i) atlas->runs[i] = NULL;
+	atlas->unused_head = atlas->unused_tail = NULL;
+	atlas->n_unused = 0;
+
+	atlas->next = ctx->atlases;
+	ctx->atlases = atlas;
+	return atlas;
+}
+
+/// \brief Copies the glyph's pixels into the atlas, leaves src empty if it doesn't fit.
+static void Atlas_Rasterize(GlyphAtlas* atlas, Glyph* glyph) {
+	char utf8[4] = { '\0' };
+	// Rendered as a one character string, so it's positioned on the line like in any text
+	if (glyph->ch < 0x80) {
+		utf8[0] = (char)glyph->ch;
+	} else if (glyph->ch < 0x800) {
+		utf8[0] = (char)(0xC0 | glyph->ch >> 6);
+		utf8[1] = (char)(0x80 | (glyph->ch & 0x3F));
+	} else {
+		utf8[0] = (char)(0xE0 | glyph->ch >> 12);
+		utf8[1] = (char)(0x80 | (glyph->ch >> 6 & 0x3F));
+		utf8[2] = (char)(0x80 | (glyph->ch & 0x3F));
+	}
+	SDL_Surface* surface = TTF_RenderUTF8_Blended(atlas->font, utf8, (SDL_Color){ 255, 255, 255, 255 });
+	if (surface == NULL) return;
+	if (surface->w > TEXT_ATLAS_WIDTH) {
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	if (atlas->pen_x + surface->w > TEXT_ATLAS_WIDTH) {
+		atlas->pen_x = 0;
+		atlas->pen_y += atlas->line_height;
+	}
+	while (atlas->pen_y + surface->h > atlas->pixels->h) {
+		if (!Atlas_Grow(atlas)) {
+			SDL_FreeSurface(surface);
+			return;
+		}
+	}
+
+	glyph->src = (SDL_Rect){ atlas->pen_x, atlas->pen_y, surface->w, surface->h };
+	SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+	SDL_BlitSurface(surface, NULL, atlas->pixels, &glyph->src);
+	atlas->pen_x += surface->w;
+
+	if (atlas->dirty_top >= atlas->dirty_bottom) {
+		atlas->dirty_top = glyph->src.y;
+		atlas->dirty_bottom = glyph->src.y + glyph->src.h;
+	} else {
+		if (glyph->src.y < atlas->dirty_top) atlas->dirty_top = glyph->src.y;
+		if (glyph->src.y + glyph->src.h > atlas->dirty_bottom) atlas->dirty_bottom = glyph->src.y + glyph->src.h;
+	}
+	SDL_FreeSurface(surface);
+}
+
+/// \brief Finds the glyph, rasterizing it the first time.
+static Glyph* Atlas_Glyph(GlyphAtlas* atlas, Uint16 ch) {
+	size_t i = ch & atlas->glyph_mask;
+	while (atlas->glyphs[i].ch != 0) {
+		if (atlas->glyphs[i].ch == ch) return &atlas->glyphs[i];
+		i = (i + 1) & atlas->glyph_mask;
+	}
+
+	// Kept at most half full
+	if ((atlas->n_glyphs + 1) * 2 > atlas->glyph_mask + 1) {
+		size_t old_size = atlas->glyph_mask + 1;
+		Glyph* old = atlas->glyphs;
+		atlas->glyph_mask = old_size * 2 - 1;
+		atlas->glyphs = RG_MALLOC(AllocTextures, old_size * 2 * sizeof(Glyph));
+		if (atlas->glyphs == NULL) exit(MALLOC_FAILED);
+		memset(atlas->glyphs, 0, old_size * 2 * sizeof(Glyph));
+		for (size_t j = 0; j < old_size; ++j) {
+			if (old[j].ch == 0) continue;
+			size_t k = old[j].ch & atlas->glyph_mask;
+			while (atlas->glyphs[k].ch != 0) k = (k + 1) & atlas->glyph_mask;
+			atlas->glyphs[k] = old[j];
+		}
+		RG_FREE(old);
+
+		i = ch & atlas->glyph_mask;
+		while (atlas->glyphs[i].ch != 0) i = (i + 1) & atlas->glyph_mask;
+	}
+
+	Glyph* glyph = &atlas->glyphs[i];
+	++atlas->n_glyphs;
+	glyph->ch = ch;
+	glyph->src = (SDL_Rect){ 0, 0, 0, 0 };
+	glyph->offset_x = 0;
+	glyph->advance = 0;
+
+	int minx, maxx, miny, maxy;
+	if (TTF_GlyphMetrics(atlas->font, ch, &minx, &maxx, &miny, &maxy, &glyph->advance) != 0) return glyph;
+	// The string rendering starts at the left of the glyph if it reaches behind the pen
+	glyph->offset_x = minx < 0 ? minx : 0;
+	if (maxx > minx) Atlas_Rasterize(atlas, glyph);
+	return glyph;
+}
+
+/* Runs */
+
+static void Unused_Remove(GlyphAtlas* atlas, TextRun* run) {
+	if (run->unused_prev != NULL) run->unused_prev->unused_next = run->unused_next;
+	else atlas->unused_head = run->unused_next;
+	if (run->unused_next != NULL) run->unused_next->unused_prev = run->unused_prev;
+	else atlas->unused_tail = run->unused_prev;
+	run->unused_prev = run->unused_next = NULL;
+	--atlas->n_unused;
+}
+
+/// \brief Lays out the string with the glyphs of the atlas, rasterizing the new ones.
+static TextRun* Run_Layout(GlyphAtlas* atlas, const char* str) {
+	size_t len = strlen(str);
+	// A character is at least one byte, so there are at most len quads
+	TextRun* run = RG_MALLOC(AllocOther, sizeof(TextRun) + len * sizeof(TextQuad) + len + 1);
+	if (run == NULL) exit(MALLOC_FAILED);
+	run->str = (char*)(run->quads + len);
+	strcpy(run->str, str);
+	run->atlas = atlas;
+	run->refs = 0;
+	run->n_quads = 0;
+	run->next = NULL;
+	run->unused_prev = run->unused_next = NULL;
+	if (atlas->font == NULL) return run;
+
+	int x = 0, y = 0;
+	Uint16 prev = 0;
+	while (*str != '\0') {
+		Uint32 ch = UTF8_Next(&str);
+		if (ch == '\n') {
+			x = 0;
+			y += atlas->line_skip;
+			prev = 0;
+			continue;
+		}
+		// SDL_ttf 2.0.14 only has the glyphs of the Basic Multilingual Plane
+		if (ch > 0xFFFF) ch = 0xFFFD;
+
+		if (prev != 0) x += TTF_GetFontKerningSizeGlyphs(atlas->font, prev, (Uint16)ch);
+		Glyph* glyph = Atlas_Glyph(atlas, (Uint16)ch);
+		if (glyph->src.w > 0) {
+			run->quads[run->n_quads++] = (TextQuad){ glyph->src, x + glyph->offset_x, y };
+		}
+		x += glyph->advance;
+		prev = (Uint16)ch;
+	}
+	return run;
+}
+
+/// \brief Takes a reference to the run of the string, laid out only if no element of the window showed it lately.
+static TextRun* Run_Get(GlyphAtlas* atlas, const char* str) {
+	TextRun** bucket = &atlas->runs[Text_Hash(str) % TEXT_RUN_BUCKETS];
+	TextRun* run;
+	for (run = *bucket; run != NULL; run = run->next) {
+		if (strcmp(run->str, str) == 0) break;
+	}
+
+	if (run == NULL) {
+		run = Run_Layout(atlas, str);
+		run->next = *bucket;
+		*bucket = run;
+	} else if (run->refs == 0) {
+		Unused_Remove(atlas, run);
+	}
+	++run->refs;
+	return run;
+}
+
+static void Run_Free(TextRun* run) {
+	GlyphAtlas* atlas = run->atlas;
+	TextRun** link = &atlas->runs[Text_Hash(run->str) % TEXT_RUN_BUCKETS];
+	while (*link != run) link = &(*link)->next;
+	*link = run->next;
+	RG_FREE(run);
+}
+
+/// \brief Drops a reference, the runs nobody uses are kept until TEXT_UNUSED_RUNS newer ones pile up.
+static void Run_Release(TextRun* run) {
+	if (run == NULL || --run->refs > 0) return;
+	GlyphAtlas* atlas = run->atlas;
+
+	run->unused_prev = NULL;
+	run->unused_next = atlas->unused_head;
+	if (atlas->unused_head != NULL) atlas->unused_head->unused_prev = run;
+	else atlas->unused_tail = run;
+	atlas->unused_head = run;
+	++atlas->n_unused;
+
+	if (atlas->n_unused > TEXT_UNUSED_RUNS) {
+		TextRun* oldest = atlas->unused_tail;
+		Unused_Remove(atlas, oldest);
+		Run_Free(oldest);
+	}
+}
+
+/* Elements */
+
+static UIElemText* Text_New(char* font, int pt_size, Uint32 color, const char* str) {
+	UIElemText* text = RG_MALLOC(AllocTree, sizeof(UIElemText));
+	if (text == NULL) exit(MALLOC_FAILED);
+	strncpy(text->font, font, 50);
+	text->font[50] = '\0';
+	text->pt_size = pt_size;
+	text->color = color;
+	text->run = NULL;
+	text->dirty = true;
+	text->capacity = strlen(str) + 1;
+	text->str = RG_MALLOC(AllocTree, text->capacity);
+	if (text->str == NULL) exit(MALLOC_FAILED);
+	strcpy(text->str, str);
+	return text;
+}
+
+UIElem* Text_Init(Vec2 position, Vec2 size, char* font, int pt_size, Uint32 color, char* str, char* name) {
+	UIElem* uie = UIElem_Init(position, size, "", 0x00000000, name);
+	uie->text = Text_New(font, pt_size, color, str);
+	return uie;
+}
+
+void Make_Text(UIElem* uie) {
+	char font[50 + 1] = { '\0' };
+	int pt_size = 0, start = 0;
+	char* data = uie->data != NULL ? uie->data : "";
+
+	if (sscanf(data, "%50s %d %n", font, &pt_size, &start) < 2) {
+		font[0] = '\0';
+		start = (int)strlen(data);
+	}
+	uie->text = Text_New(font, pt_size, uie->color, data + start);
+	uie->color = 0x00000000;
+
+	if (uie->data != NULL) RG_FREE(uie->data);
+	uie->data = NULL;
+}
+
+void Text_Set(UIElem* uie, const char* str) {
+	UIElemText* text = uie->text;
+	if (text == NULL || strcmp(text->str, str) == 0) return;
+
+	size_t len = strlen(str);
+	if (len + 1 > text->capacity) {
+		size_t capacity = text->capacity * 2 > len + 1 ? text->capacity * 2 : len + 1;
+		char* new_str = RG_MALLOC(AllocTree, capacity);
+		if (new_str == NULL) exit(MALLOC_FAILED);
+		RG_FREE(text->str);
+		text->str = new_str;
+		text->capacity = capacity;
+	}
+	strcpy(text->str, str);
+	text->dirty = true;
+}
+
+void Text_SetFont(UIElem* uie, char* font, int pt_size) {
+	UIElemText* text = uie->text;
+	if (text == NULL || (text->pt_size == pt_size && strcmp(text->font, font) == 0)) return;
+	strncpy(text->font, font, 50);
+	text->font[50] = '\0';
+	text->pt_size = pt_size;
+	text->dirty = true;
+}
+
+UIElemText* Text_Copy(UIElemText* text) {
+	if (text == NULL) return NULL;
+	UIElemText* copy = Text_New(text->font, text->pt_size, text->color, text->str);
+	copy->run = text->run;
+	copy->dirty = text->dirty;
+	if (copy->run != NULL) ++copy->run->refs;
+	return copy;
+}
+
+void Text_Free(UIElemText* text) {
+	if (text == NULL) return;
+	Run_Release(text->run);
+	RG_FREE(text->str);
+	RG_FREE(text);
+}
+
+void Text_Draw(UIContext* ctx, UIElem* uie, Scene* scene, SDL_Rect* visible) {
+	UIElemText* text = uie->text;
+	if (text->font[0] == '\0') return;
+
+	// Moved into another window, the glyphs are in the atlas of that one
+	if (text->run != NULL && text->run->atlas->ctx != ctx) text->dirty = true;
+	if (text->dirty) {
+		// Taken before releasing the old one, so setting the same string again doesn't lay it out
+		TextRun* run = Run_Get(Atlas_Get(ctx, text->font, text->pt_size), text->str);
+		Run_Release(text->run);
+		text->run = run;
+		text->dirty = false;
+	}
+
+	TextRun* run = text->run;
+	SDL_Texture* tex = run->atlas->tex;
+	if (tex == NULL) return;
+
+	for (size_t i = 0; i < run->n_quads; ++i) {
+		TextQuad* quad = &run->quads[i];
+		SDL_Rect dst = { uie->abs_position.X + quad->x, uie->abs_position.Y + quad->y, quad->src.w, quad->src.h };
+		SDL_Rect part;
+		if (!SDL_IntersectRect(&dst, visible, &part)) continue;
+
+		// Copied 1:1, so the source is cut like the destination
+		SDL_Rect src = {
+			quad->src.x + part.x - dst.x, quad->src.y + part.y - dst.y,
+			part.w, part.h
+		};
+		Scene_AddCopy(scene, &part, &src, text->color, tex);
+	}
+}
+
+void Text_Flush(UIContext* ctx) {
+	for (GlyphAtlas* atlas = ctx->atlases; atlas != NULL; atlas = atlas->next) {
+		// The textures replaced in earlier frames aren't in the scene being rendered
+		int kept = 0;
+		for (int i = 0; i < atlas->n_retired; ++i) {
+			if (atlas->retired[i].frame < ctx->frame) Atlas_DestroyTexture(atlas, atlas->retired[i].tex);
+			else atlas->retired[kept++] = atlas->retired[i];
+		}
+		atlas->n_retired = kept;
+
+		if (atlas->tex == NULL || atlas->dirty_top >= atlas->dirty_bottom) continue;
+		// Only the new glyphs are written, the rows of the older ones don't change under the render thread
+		SDL_Rect rows = { 0, atlas->dirty_top, atlas->pixels->w, atlas->dirty_bottom - atlas->dirty_top };
+		RGUI_LockRenderer(ctx->window);
+		SDL_UpdateTexture(atlas->tex, &rows,
+			(Uint8*)atlas->pixels->pixels + (size_t)rows.y * atlas->pixels->pitch, atlas->pixels->pitch);
+		RGUI_UnlockRenderer(ctx->window);
+		atlas->dirty_top = atlas->dirty_bottom = 0;
+	}
+}
+
+void Text_FreeAtlases(UIContext* ctx) {
+	GlyphAtlas* atlas;
+	while ((atlas = ctx->atlases) != NULL) {
+		ctx->atlases = atlas->next;
+
+		for (int i = 0; i < TEXT_RUN_BUCKETS; ++i) {
+			TextRun* run = atlas->runs[i];
+			while (run != NULL) {
+				TextRun* next = run->next;
+				RG_FREE(run);
+				run = next;
+			}
+		}
+		for (int i = 0; i < atlas->n_retired; ++i) Atlas_DestroyTexture(atlas, atlas->retired[i].tex);
+		Atlas_DestroyTexture(atlas, atlas->tex);
+		SDL_FreeSurface(atlas->pixels);
+		RG_FREE(atlas->glyphs);
+		if (atlas->font != NULL) TTF_CloseFont(atlas->font);
+		RG_FREE(atlas);
+	}
+}
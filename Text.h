@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef TEXT_H
+#define TEXT_H
+
+/// \brief A glyph atlas texture is this wide, it grows in height.
+#define TEXT_ATLAS_WIDTH 512
+/// \brief The tallest an atlas grows, the glyphs which don't fit aren't drawn.
+#define TEXT_ATLAS_MAX_HEIGHT 4096
+/// \brief The shaped runs no element uses which are kept per atlas, the oldest is freed first.
+#define TEXT_UNUSED_RUNS 512
+
+/// \brief The string drawn on a text element, stored in UIElem.text.
+///
+/// The glyphs of every font and size are rasterized once into one atlas texture
+/// per window, and the laid out runs are shared by the elements showing the same
+/// string, so changing a label doesn't create a texture, only looks up or lays out its run.
+typedef struct UIElemText {
+	/// \brief The string in UTF-8, '\n' starts a new line.
+	char* str;
+	size_t capacity;
+	/// \brief The path of the .ttf file, MAX 50 character.
+	char font[51];
+	int pt_size;
+	/// \brief The color of the glyphs.
+	Uint32 color;
+	/// \brief The laid out string, NULL until the element is drawn after a change.
+	struct TextRun* run;
+	/// \brief The string or the font changed since the run was laid out.
+	bool dirty;
+} UIElemText;
+
+/// \brief Creates an element showing the string, with a transparent background.
+///
+/// \param font		The path of the .ttf file, MAX 50 character.
+/// \param pt_size	The size of the font.
+/// \param color	The color of the text.
+UIElem* Text_Init(Vec2 position, Vec2 size, char* font, int pt_size, Uint32 color, char* str, char* name);
+/// \brief The builder of "text", the data is "font.ttf pt_size string", the color is the text's.
+void Make_Text(UIElem* uie);
+/// \brief Changes the string of the element, it's laid out again when it's drawn.
+///
+/// Only touches the element, so it can be called from the element's parallel Tick.
+void Text_Set(UIElem* uie, const char* str);
+/// \brief Changes the font of the element, MAX 50 character path.
+void Text_SetFont(UIElem* uie, char* font, int pt_size);
+
+/// \brief A copy of the text for UIElem_Instantiate, sharing the run.
+UIElemText* Text_Copy(UIElemText* text);
+/// \brief Frees the text of an element.
+void Text_Free(UIElemText* text);
+/// \brief Records the glyphs of the element's text inside the visible rect, laying it out if it changed.
+void Text_Draw(UIContext* ctx, UIElem* uie, Scene* scene, SDL_Rect* visible);
+/// \brief Uploads the glyphs rasterized while drawing the frame into the atlas textures.
+void Text_Flush(UIContext* ctx);
+/// \brief Frees the atlases and the runs of the window, after its elements were deleted.
+void Text_FreeAtlases(UIContext* ctx);
+
+#endif
@@ -0,0 +1,252 @@
+#include <string.h>
+
+#include "Alloc.h"
+#include "TickPool.h"
+
+#ifdef _MSC_VER
+#define TICK_THREAD_LOCAL __declspec(thread)
+#else
+#define TICK_THREAD_LOCAL _Thread_local
+#endif
+
+typedef enum TickChangeType {
+	TickMove,
+	TickResize
+} TickChangeType;
+
+typedef struct TickChange {
+	TickChangeType type;
+	UIElem* uie;
+	Vec2 value;
+} TickChange;
+
+/// \brief The layout changes of one worker in the order they were made.
+typedef struct TickLog {
+	TickChange* changes;
+	size_t count;
+	size_t capacity;
+} TickLog;
+
+typedef struct TickWorker {
+	struct TickPool* pool;
+	SDL_Thread* thread;
+	/// \brief Guards the deque, the owner takes from the back, thieves from the front.
+	SDL_SpinLock lock;
+	UIElem** tasks;
+	int front;
+	int back;
+	TickLog log;
+} TickWorker;
+
+struct TickPool {
+	int n_workers;
+	TickWorker* workers;
+	/// \brief Posted once per worker thread to start a run.
+	SDL_sem* start;
+	/// \brief Posted by every worker thread at the end of a run.
+	SDL_sem* done;
+	SDL_atomic_t quit;
+	/// \brief The size of every worker's task array.
+	int task_capacity;
+	/// \brief The rect of the root, the clip of the tasks.
+	SDL_Rect clip;
+};
+
+/// \brief The log of the worker running on this thread, NULL outside TickPool_Run.
+static TICK_THREAD_LOCAL TickLog* _Log = NULL;
+/// \brief The number of flagged elements, without any TickPool_Run does nothing.
+static SDL_atomic_t _N_Parallel;
+
+static void Log_Add(TickLog* log, TickChangeType type, UIElem* uie, Vec2 value) {
+	if (log->count == log->capacity) {
+		size_t capacity = log->capacity == 0 ? 64 : log->capacity * 2;
+		TickChange* changes = RG_MALLOC(AllocOther, capacity * sizeof(TickChange));
+		if (changes == NULL) exit(MALLOC_FAILED);
+		if (log->changes != NULL) {
+			memcpy(changes, log->changes, log->count * sizeof(TickChange));
+			RG_FREE(log->changes);
+		}
+		log->changes = changes;
+		log->capacity = capacity;
+	}
+	log->changes[log->count++] = (TickChange){ type, uie, value };
+}
+
+static void Apply_Change(TickChangeType type, UIElem* uie, Vec2 value) {
+	if (type == TickMove) {
+		uie->rel_position = value;
+		UIElem_Update(uie);
+	} else {
+		uie->size = value;
+	}
+}
+
+void TickPool_SetParallel(UIElem* uie, bool parallel) {
+	if (uie->parallel_tick == parallel) return;
+	uie->parallel_tick = parallel;
+	SDL_AtomicAdd(&_N_Parallel, parallel ? 1 : -1);
+}
+void TickPool_Move(UIElem* uie, Vec2 position) {
+	if (_Log != NULL) Log_Add(_Log, TickMove, uie, position);
+	else Apply_Change(TickMove, uie, position);
+}
+void TickPool_Resize(UIElem* uie, Vec2 size) {
+	if (_Log != NULL) Log_Add(_Log, TickResize, uie, size);
+	else Apply_Change(TickResize, uie, size);
+}
+
+static SDL_Rect Elem_Rect(UIElem* uie) {
+	return (SDL_Rect){ uie->abs_position.X, uie->abs_position.Y, uie->size.X, uie->size.Y };
+}
+static void Tick_Subtree(UIElem* uie, SDL_Rect* clip);
+/// \brief Runs the flagged Tick callbacks of the element and its subtree.
+///
+/// Culled like UIElem_Draw culls: the children of a clipping element outside the clip are skipped.
+static void Tick_Elem(UIElem* uie, SDL_Rect* clip) {
+	if (uie->parallel_tick) UIElem_TriggerEvent(uie, Tick);
+	if (uie->child == NULL) return;
+
+	if (!uie->clip) {
+		Tick_Subtree(uie->child, clip);
+		return;
+	}
+	SDL_Rect rect = Elem_Rect(uie);
+	SDL_Rect visible;
+	if (SDL_IntersectRect(&rect, clip, &visible)) Tick_Subtree(uie->child, &visible);
+}
+/// \brief Runs Tick_Elem on the siblings from uie on.
+static void Tick_Subtree(UIElem* uie, SDL_Rect* clip) {
+	for (; uie != NULL; uie = uie->sibling) Tick_Elem(uie, clip);
+}
+
+/// \brief Takes a task from the back of the own deque, or steals one from the front of another.
+static UIElem* Next_Task(TickPool* pool, int self) {
+	for (int i = 0; i < pool->n_workers; ++i) {
+		TickWorker* worker = &pool->workers[(self + i) % pool->n_workers];
+		UIElem* task = NULL;
+
+		SDL_AtomicLock(&worker->lock);
+		if (worker->front < worker->back) {
+			task = i == 0 ? worker->tasks[--worker->back] : worker->tasks[worker->front++];
+		}
+		SDL_AtomicUnlock(&worker->lock);
+
+		if (task != NULL) return task;
+	}
+	return NULL;
+}
+
+static void Work(TickPool* pool, int self) {
+	_Log = &pool->workers[self].log;
+	UIElem* task;
+	// Every task is queued before the run starts, so empty deques mean done
+	while ((task = Next_Task(pool, self)) != NULL) Tick_Elem(task, &pool->clip);
+	_Log = NULL;
+}
+
+static int Worker_Thread(void* data) {
+	TickWorker* worker = data;
+	TickPool* pool = worker->pool;
+	int self = (int)(worker - pool->workers);
+
+	while (true) {
+		SDL_SemWait(pool->start);
+		if (SDL_AtomicGet(&pool->quit)) break;
+		Work(pool, self);
+		SDL_SemPost(pool->done);
+	}
+	return 0;
+}
+
+TickPool* TickPool_Create(int n_threads) {
+	if (n_threads < 1) n_threads = 1;
+
+	TickPool* pool = RG_MALLOC(AllocOther, sizeof(TickPool));
+	TickWorker* workers = RG_MALLOC(AllocOther, n_threads * sizeof(TickWorker));
+	if (pool == NULL || workers == NULL) exit(MALLOC_FAILED);
+
+	pool->n_workers = n_threads;
+	pool->workers = workers;
+	pool->start = SDL_CreateSemaphore(0);
+	pool->done = SDL_CreateSemaphore(0);
+	if (pool->start == NULL || pool->done == NULL) exit(INIT_FAILED);
+	SDL_AtomicSet(&pool->quit, 0);
+	pool->task_capacity = 0;
+
+	for (int i = 0; i < n_threads; ++i) {
+		workers[i].pool = pool;
+		workers[i].lock = 0;
+		workers[i].tasks = NULL;
+		workers[i].front = workers[i].back = 0;
+		workers[i].log = (TickLog){ NULL, 0, 0 };
+		// The caller of TickPool_Run is worker 0
+		workers[i].thread = i == 0 ? NULL : SDL_CreateThread(Worker_Thread, "RGUI tick", &workers[i]);
+		if (i != 0 && workers[i].thread == NULL) exit(INIT_FAILED);
+	}
+	return pool;
+}
+
+void TickPool_Destroy(TickPool* pool) {
+	if (pool == NULL) return;
+
+	SDL_AtomicSet(&pool->quit, 1);
+	for (int i = 1; i < pool->n_workers; ++i) SDL_SemPost(pool->start);
+	for (int i = 0; i < pool->n_workers; ++i) {
+		if (pool->workers[i].thread != NULL) SDL_WaitThread(pool->workers[i].thread, NULL);
+		RG_FREE(pool->workers[i].tasks);
+		RG_FREE(pool->workers[i].log.changes);
+	}
+
+	SDL_DestroySemaphore(pool->start);
+	SDL_DestroySemaphore(pool->done);
+	RG_FREE(pool->workers);
+	RG_FREE(pool);
+}
+
+void TickPool_Run(TickPool* pool, UIElem* root) {
+	if (root == NULL || SDL_AtomicGet(&_N_Parallel) == 0) return;
+	if (root->parallel_tick) UIElem_TriggerEvent(root, Tick);
+
+	// The children of the root are drawn inside its rect, whether it clips or not
+	SDL_Rect clip = Elem_Rect(root);
+	if (pool == NULL) {
+		Tick_Subtree(root->child, &clip);
+		return;
+	}
+	pool->clip = clip;
+
+	int n_tasks = 0;
+	for (UIElem* child = root->child; child != NULL; child = child->sibling) ++n_tasks;
+	if (n_tasks == 0) return;
+
+	if (n_tasks > pool->task_capacity) {
+		for (int i = 0; i < pool->n_workers; ++i) {
+			RG_FREE(pool->workers[i].tasks);
+			pool->workers[i].tasks = RG_MALLOC(AllocOther, n_tasks * sizeof(UIElem*));
+			if (pool->workers[i].tasks == NULL) exit(MALLOC_FAILED);
+		}
+		pool->task_capacity = n_tasks;
+	}
+
+	// Round robin, the workers even it out by stealing
+	int i = 0;
+	for (UIElem* child = root->child; child != NULL; child = child->sibling, ++i) {
+		TickWorker* worker = &pool->workers[i % pool->n_workers];
+		worker->tasks[worker->back++] = child;
+	}
+
+	for (int w = 1; w < pool->n_workers; ++w) SDL_SemPost(pool->start);
+	Work(pool, 0);
+	for (int w = 1; w < pool->n_workers; ++w) SDL_SemWait(pool->done);
+
+	// Merged in worker order, the changes of one element stay in their order
+	for (int w = 0; w < pool->n_workers; ++w) {
+		TickWorker* worker = &pool->workers[w];
+		for (size_t c = 0; c < worker->log.count; ++c) {
+			TickChange* change = &worker->log.changes[c];
+			Apply_Change(change->type, change->uie, change->value);
+		}
+		worker->log.count = 0;
+		worker->front = worker->back = 0;
+	}
+}
@@ -0,0 +1,33 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef TICK_POOL_H
+#define TICK_POOL_H
+
+/// \brief Runs the Tick callbacks of the elements flagged with parallel_tick before the drawing.
+///
+/// The subtrees of the root's children are the tasks, they are spread over
+/// the workers which steal from each other when they run out.
+/// The flagged callbacks must only touch their own element's subtree and
+/// must change positions and sizes through TickPool_Move and TickPool_Resize,
+/// these are logged per thread and applied after every task finished.
+/// The subtrees UIElem_Draw culls are skipped too (see Tick).
+typedef struct TickPool TickPool;
+
+/// \brief Creates a pool with n_threads workers, the caller of TickPool_Run counts as one.
+TickPool* TickPool_Create(int n_threads);
+/// \brief Joins the workers and frees the pool.
+void TickPool_Destroy(TickPool* pool);
+/// \brief Runs the flagged Tick callbacks under root, serially on the caller if pool is NULL.
+void TickPool_Run(TickPool* pool, UIElem* root);
+
+/// \brief Sets whether the Tick callbacks of the element run in TickPool_Run instead of UIElem_Draw.
+void TickPool_SetParallel(UIElem* uie, bool parallel);
+/// \brief Moves the element relative to its parent, deferred while TickPool_Run runs.
+void TickPool_Move(UIElem* uie, Vec2 position);
+/// \brief Resizes the element, deferred while TickPool_Run runs.
+void TickPool_Resize(UIElem* uie, Vec2 size);
+
+#endif
@@ -0,0 +1,169 @@
+#include "Alloc.h"
+#include "RGUI.h"
+#include "Timer.h"
+
+#define TIMER_MASK (TIMER_SLOTS - 1)
+
+void TimerWheel_Init(TimerWheel* wheel, Uint32 now) {
+	for (int level = 0; level < TIMER_LEVELS; ++level) {
+		for (int slot = 0; slot < TIMER_SLOTS; ++slot) wheel->slots[level][slot] = NULL;
+	}
+	wheel->now = now;
+	wheel->count = 0;
+}
+
+/// \brief Puts the timer into the slot of the level its deadline fits.
+static void Wheel_Insert(TimerWheel* wheel, Timer* timer) {
+	Uint32 delta = timer->expires - wheel->now;
+	int level = 0;
+	while (level < TIMER_LEVELS - 1 && delta >= 1u << (TIMER_SLOT_BITS * (level + 1))) ++level;
+
+	// Farther than the wheel reaches, it's put back in when its slot comes up
+	Uint32 expires = timer->expires;
+	Uint32 reach = 1u << (TIMER_SLOT_BITS * TIMER_LEVELS);
+	if (delta >= reach) expires = wheel->now + reach - 1;
+
+	Timer** slot = &wheel->slots[level][(expires >> (TIMER_SLOT_BITS * level)) & TIMER_MASK];
+	timer->next = *slot;
+	if (*slot != NULL) (*slot)->pprev = &timer->next;
+	timer->pprev = slot;
+	*slot = timer;
+}
+static void Wheel_Remove(Timer* timer) {
+	*timer->pprev = timer->next;
+	if (timer->next != NULL) timer->next->pprev = timer->pprev;
+}
+
+static void Timer_Free(Timer* timer) {
+	Wheel_Remove(timer);
+	*timer->elem_pprev = timer->elem_next;
+	if (timer->elem_next != NULL) timer->elem_next->elem_pprev = timer->elem_pprev;
+	--timer->wheel->count;
+	RG_FREE(timer);
+}
+
+/// \brief Moves the timers of a slot down to the lower levels.
+static void Cascade(TimerWheel* wheel, int level, int slot) {
+	Timer* timer = wheel->slots[level][slot];
+	wheel->slots[level][slot] = NULL;
+	while (timer != NULL) {
+		Timer* next = timer->next;
+		Wheel_Insert(wheel, timer);
+		timer = next;
+	}
+}
+
+/// \brief The first ms after wheel->now with a deadline in level 0 or a cascade from a higher level.
+static Uint32 Next_Tick(TimerWheel* wheel) {
+	Uint32 next = wheel->now + (1u << (TIMER_SLOT_BITS * TIMER_LEVELS));
+	for (int level = 0; level < TIMER_LEVELS; ++level) {
+		int shift = TIMER_SLOT_BITS * level;
+		Uint32 block = wheel->now >> shift;
+		for (Uint32 k = 1; k <= TIMER_SLOTS; ++k) {
+			if (wheel->slots[level][(block + k) & TIMER_MASK] != NULL) {
+				Uint32 at = (block + k) << shift;
+				if ((Sint32)(at - next) < 0) next = at;
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+/// \brief Processes the ms wheel->now, the wheel is being advanced until target.
+static void Wheel_Tick(TimerWheel* wheel, Uint32 target) {
+	Uint32 now = wheel->now;
+
+	// From the highest level which wrapped around, so the timers can fall more levels
+	int top = 0;
+	while (top < TIMER_LEVELS - 1 && (now & ((1u << (TIMER_SLOT_BITS * (top + 1))) - 1)) == 0) ++top;
+	for (int level = top; level > 0; --level) {
+		Cascade(wheel, level, (now >> (TIMER_SLOT_BITS * level)) & TIMER_MASK);
+	}
+
+	// The callbacks may start and stop timers, so the slot is re-read every time
+	Timer** slot = &wheel->slots[0][now & TIMER_MASK];
+	while (*slot != NULL) {
+		Timer* timer = *slot;
+		UIElem* uie = timer->uie;
+		UIElem_EventCallback callback = timer->callback;
+
+		if (timer->interval != 0) {
+			Wheel_Remove(timer);
+			timer->expires = now + timer->interval;
+			// The periods missed while the wheel wasn't advanced fire once
+			Uint32 behind = target - timer->expires;
+			if ((Sint32)behind >= 0) timer->expires += (behind / timer->interval + 1) * timer->interval;
+			Wheel_Insert(wheel, timer);
+		} else {
+			Timer_Free(timer);
+		}
+		callback(uie);
+	}
+}
+
+void TimerWheel_Advance(TimerWheel* wheel, Uint32 now) {
+	while ((Sint32)(now - wheel->now) > 0) {
+		// The ms without anything to fire or cascade are skipped, so a long sleep doesn't step through them
+		Uint32 next = wheel->count == 0 ? now : Next_Tick(wheel);
+		if ((Sint32)(next - now) > 0) {
+			wheel->now = now;
+			return;
+		}
+		wheel->now = next;
+		Wheel_Tick(wheel, now);
+	}
+}
+
+Sint32 TimerWheel_Timeout(TimerWheel* wheel, Uint32 now) {
+	if (wheel->count == 0) return -1;
+
+	Sint32 timeout = (Sint32)(Next_Tick(wheel) - now);
+	return timeout > 0 ? timeout : 0;
+}
+
+void TimerWheel_Free(TimerWheel* wheel) {
+	for (int level = 0; level < TIMER_LEVELS; ++level) {
+		for (int slot = 0; slot < TIMER_SLOTS; ++slot) {
+			while (wheel->slots[level][slot] != NULL) Timer_Free(wheel->slots[level][slot]);
+		}
+	}
+}
+
+bool Timer_Start(UIElem* uie, Uint32 delay, Uint32 interval, UIElem_EventCallback callback) {
+	UIContext* ctx = UIElem_Context(uie);
+	if (ctx == NULL) return false;
+	TimerWheel* wheel = &ctx->window->timers;
+
+	Timer* timer = RG_MALLOC(AllocCallbacks, sizeof(Timer));
+	if (timer == NULL) exit(MALLOC_FAILED);
+
+	timer->expires = SDL_GetTicks() + delay;
+	// It can't fire in the ms which is being processed
+	if ((Sint32)(timer->expires - wheel->now) <= 0) timer->expires = wheel->now + 1;
+	timer->interval = interval;
+	timer->uie = uie;
+	timer->callback = callback;
+	timer->wheel = wheel;
+	Wheel_Insert(wheel, timer);
+	++wheel->count;
+
+	timer->elem_next = uie->timers;
+	if (uie->timers != NULL) uie->timers->elem_pprev = &timer->elem_next;
+	timer->elem_pprev = &uie->timers;
+	uie->timers = timer;
+	return true;
+}
+
+void Timer_Stop(UIElem* uie, UIElem_EventCallback callback) {
+	Timer* timer = uie->timers;
+	while (timer != NULL) {
+		Timer* next = timer->elem_next;
+		if (timer->callback == callback) Timer_Free(timer);
+		timer = next;
+	}
+}
+
+void Timer_StopAll(UIElem* uie) {
+	while (uie->timers != NULL) Timer_Free(uie->timers);
+}
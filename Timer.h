@@ -0,0 +1,62 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#include "UIElem.h"
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#define TIMER_LEVELS 4
+#define TIMER_SLOT_BITS 6
+#define TIMER_SLOTS (1 << TIMER_SLOT_BITS)
+
+/// \brief A scheduled callback bound to an element.
+typedef struct Timer {
+	/// \brief SDL_GetTicks() of the next firing.
+	Uint32 expires;
+	/// \brief 0 for a one-shot timer.
+	Uint32 interval;
+	UIElem* uie;
+	UIElem_EventCallback callback;
+	struct TimerWheel* wheel;
+	/// \brief The links in the slot of the wheel.
+	struct Timer *next, **pprev;
+	/// \brief The links in the list of the element's timers.
+	struct Timer *elem_next, **elem_pprev;
+} Timer;
+
+/// \brief The timers of a window, in a hierarchical wheel with 1 ms resolution.
+///
+/// Level L has TIMER_SLOTS slots of 64^L ms, a timer goes into the level its
+/// delay fits and moves down a level whenever the lower level wraps around,
+/// so starting and stopping are O(1), and advancing skips the ms with nothing to fire or move down.
+/// Delays over 64^TIMER_LEVELS ms (~4.6 hours) are moved down in several steps.
+typedef struct TimerWheel {
+	Timer* slots[TIMER_LEVELS][TIMER_SLOTS];
+	/// \brief The ms processed until now.
+	Uint32 now;
+	int count;
+} TimerWheel;
+
+/// \brief Initializes an empty wheel starting at now.
+void TimerWheel_Init(TimerWheel* wheel, Uint32 now);
+/// \brief Frees the timers left in the wheel.
+void TimerWheel_Free(TimerWheel* wheel);
+/// \brief Fires the timers expired until now, in the order of their deadlines.
+///
+/// A repeating timer which missed several periods fires once, then every interval after now.
+void TimerWheel_Advance(TimerWheel* wheel, Uint32 now);
+/// \brief The ms from now until the wheel has to be advanced, -1 if it has no timers.
+Sint32 TimerWheel_Timeout(TimerWheel* wheel, Uint32 now);
+
+/// \brief Calls callback on the element after delay ms, then every interval ms if it isn't 0.
+///
+/// The element must be in a window, the timer goes into the wheel of that window.
+/// \return false if the element isn't in a window.
+bool Timer_Start(UIElem* uie, Uint32 delay, Uint32 interval, UIElem_EventCallback callback);
+/// \brief Stops the timers of the element with the given callback.
+void Timer_Stop(UIElem* uie, UIElem_EventCallback callback);
+/// \brief Stops every timer of the element, UIElem_Delete calls it.
+void Timer_StopAll(UIElem* uie);
+
+#endif
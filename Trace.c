@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "Alloc.h"
+#include "Error.h"
+#include "Trace.h"
+
+#ifdef _MSC_VER
+#define TRACE_THREAD_LOCAL __declspec(thread)
+#else
+#define TRACE_THREAD_LOCAL _Thread_local
+#endif
+
+/// \brief The number of spans kept per thread, a power of two.
+#define TRACE_RING_SIZE (1 << 15)
+#define TRACE_LABEL_LENGTH 31
+
+typedef struct TraceSpan {
+	const char* name;
+	char label[TRACE_LABEL_LENGTH + 1];
+	Uint64 begin;
+	Uint64 end;
+} TraceSpan;
+
+/// \brief Written only by its own thread, the head is published after the span is complete.
+typedef struct TraceRing {
+	SDL_threadID thread;
+	SDL_atomic_t head;
+	struct TraceRing* next;
+	TraceSpan spans[TRACE_RING_SIZE];
+} TraceRing;
+
+/// \brief Lock-free list of every ring ever created, new rings are pushed to the front.
+static void* _Rings = NULL;
+static TRACE_THREAD_LOCAL TraceRing* _Ring = NULL;
+/// \brief The first Trace_Now() of the process, written once under _OriginLock before _Started is set.
+///
+/// Another thread's first span may have read the counter a bit earlier, so it can begin before it.
+static Uint64 _Origin = 0;
+static SDL_atomic_t _Started;
+static SDL_SpinLock _OriginLock = 0;
+
+static TraceRing* Trace_ThreadRing(void) {
+	if (_Ring != NULL) return _Ring;
+
+	TraceRing* ring = RG_MALLOC(AllocOther, sizeof(TraceRing));
+	if (ring == NULL) exit(MALLOC_FAILED);
+	ring->thread = SDL_ThreadID();
+	SDL_AtomicSet(&ring->head, 0);
+
+	do {
+		ring->next = SDL_AtomicGetPtr(&_Rings);
+	} while (!SDL_AtomicCASPtr(&_Rings, ring->next, ring));
+
+	return _Ring = ring;
+}
+
+Uint64 Trace_Now(void) {
+	Uint64 now = SDL_GetPerformanceCounter();
+	// Only the first spans take the lock, the threads may start tracing at the same time
+	if (!SDL_AtomicGet(&_Started)) {
+		SDL_AtomicLock(&_OriginLock);
+		if (!SDL_AtomicGet(&_Started)) {
+			_Origin = now;
+			SDL_AtomicSet(&_Started, 1);
+		}
+		SDL_AtomicUnlock(&_OriginLock);
+	}
+	return now;
+}
+
+void Trace_Span(const char* name, const char* label, Uint64 begin) {
+	TraceRing* ring = Trace_ThreadRing();
+	int head = SDL_AtomicGet(&ring->head);
+	TraceSpan* span = &ring->spans[head & (TRACE_RING_SIZE - 1)];
+
+	span->name = name;
+	span->begin = begin;
+	span->end = SDL_GetPerformanceCounter();
+	if (label != NULL) {
+		strncpy(span->label, label, TRACE_LABEL_LENGTH);
+		span->label[TRACE_LABEL_LENGTH] = '\0';
+	} else {
+		span->label[0] = '\0';
+	}
+
+	SDL_AtomicSet(&ring->head, head + 1);
+}
+
+/// \brief Writes a string into a JSON string literal.
+static void Write_Escaped(FILE* out, const char* str) {
+	for (; *str != '\0'; ++str) {
+		if (*str == '"' || *str == '\\') fputc('\\', out);
+		if ((unsigned char)*str < 0x20) fputc(' ', out);
+		else fputc(*str, out);
+	}
+}
+
+bool Trace_Flush(char* file_name) {
+	FILE* out = fopen(file_name, "w");
+	if (out == NULL) return false;
+
+	double us_per_tick = 1000000.0 / SDL_GetPerformanceFrequency();
+	bool first = true;
+
+	fprintf(out, "{\"traceEvents\":[\n");
+	for (TraceRing* ring = SDL_AtomicGetPtr(&_Rings); ring != NULL; ring = ring->next) {
+		int head = SDL_AtomicGet(&ring->head);
+		int start = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+		for (int i = start; i < head; ++i) {
+			TraceSpan* span = &ring->spans[i & (TRACE_RING_SIZE - 1)];
+
+			fprintf(out, first ? "{\"name\":\"" : ",\n{\"name\":\"");
+			Write_Escaped(out, span->name);
+			if (span->label[0] != '\0') {
+				fputc(' ', out);
+				Write_Escaped(out, span->label);
+			}
+			// Signed, a span which began before the origin gets a small negative ts instead of a wrapped one
+			fprintf(out, "\",\"cat\":\"rgui\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%lu}",
+				(Sint64)(span->begin - _Origin) * us_per_tick,
+				(span->end - span->begin) * us_per_tick,
+				(unsigned long)ring->thread
+			);
+			first = false;
+		}
+	}
+	fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+
+	fclose(out);
+	return true;
+}
+
+void Trace_Free(void) {
+	TraceRing* ring = SDL_AtomicGetPtr(&_Rings);
+	SDL_AtomicSetPtr(&_Rings, NULL);
+	while (ring != NULL) {
+		TraceRing* next = ring->next;
+		RG_FREE(ring);
+		ring = next;
+	}
+	_Ring = NULL;
+}
@@ -0,0 +1,42 @@
+#include <stdbool.h>
+#include <SDL.h>
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/// \brief Optional span tracing which can be opened in chrome://tracing or Perfetto.
+///
+/// The spans are compiled in only when RGUI_TRACE is defined,
+/// without it the TRACE_ macros expand to nothing.
+/// Every thread writes into its own ring buffer without locking,
+/// when a ring is full the oldest spans are overwritten.
+
+#ifdef RGUI_TRACE
+/// \brief Starts a span, the variable holds the start time.
+#define TRACE_BEGIN(var) Uint64 var = Trace_Now()
+/// \brief Closes the span started with TRACE_BEGIN(var).
+#define TRACE_END(var, name, label) Trace_Span((name), (label), (var))
+#else
+#define TRACE_BEGIN(var)
+#define TRACE_END(var, name, label)
+#endif
+
+/// \brief The performance counter value used as the start of a span.
+Uint64 Trace_Now(void);
+/// \brief Records a finished span into the ring of the calling thread.
+///
+/// \param name		Must be a string literal (only the pointer is stored).
+/// \param label	Copied, can be NULL, eg. the name of an element.
+/// \param begin	The value of Trace_Now() when the span started.
+void Trace_Span(const char* name, const char* label, Uint64 begin);
+/// \brief Writes every recorded span as Chrome trace-event JSON, the rings are kept.
+///
+/// The rings are read without locking, so the threads which record spans must be
+/// quiescent (eg. the tick pool and the loader idle) while it runs, otherwise
+/// a span being overwritten may be written half updated.
+/// \return false if the file can't be opened.
+bool Trace_Flush(char* file_name);
+/// \brief Frees the ring buffers, should be called when no other thread records anymore.
+void Trace_Free(void);
+
+#endif
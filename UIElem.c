@@ -1,31 +1,326 @@
-#include <debugmalloc.h>
-#include <debugmalloc-impl.h>
-#include <SDL_image.h>
-
+#include "Alloc.h"
 #include "RGUI.h"
 #include "UIElem.h"
+#include "Trace.h"
+#include "TickPool.h"
+#include "Timer.h"
+#include "Task.h"
+#include "PixelCache.h"
+#include "Resample.h"
+#include "Loader.h"
+#include "Text.h"
+
+
+/* Shared parts */
+
+/// \brief A texture decoded by the loader thread, uploaded by UIContext_FinishLoads.
+typedef struct TextureLoad {
+	UIElemTexture* tex;
+	UIContext* ctx;
+	char path[51];
+	Vec2 size;
+	/// \brief The pixel format of the window when it was requested.
+	Uint32 native;
+	/// \brief NULL if the image couldn't be loaded.
+	SDL_Surface* pixels;
+	struct TextureLoad* next;
+} TextureLoad;
+
+/// \brief A new unloaded texture with one reference, NULL for an empty path.
+static UIElemTexture* Texture_New(char* tex_path) {
+	if (tex_path == NULL || tex_path[0] == '\0') return NULL;
+
+	UIElemTexture* tex = RG_MALLOC(AllocTextures, sizeof(UIElemTexture));
+	if (tex == NULL) exit(MALLOC_FAILED);
+	strcpy(tex->path, tex_path);
+	tex->size = (Vec2){ 0, 0 };
+	tex->tex = NULL;
+	tex->refs = 1;
+	tex->ctx = NULL;
+	tex->next = NULL;
+	tex->bytes = 0;
+	tex->last_drawn = 0;
+	tex->lru_prev = tex->lru_next = NULL;
+	tex->evicted = false;
+	tex->loading = false;
+	return tex;
+}
+static size_t Texture_Bucket(char* path) {
+	Uint32 hash = 2166136261u;
+	for (; *path != '\0'; ++path) hash = (hash ^ (Uint8)*path) * 16777619u;
+	return hash % UI_TEXTURE_BUCKETS;
+}
+
+static void LRU_Remove(UIContext* ctx, UIElemTexture* tex) {
+	if (tex->lru_prev != NULL) tex->lru_prev->lru_next = tex->lru_next;
+	else ctx->lru_head = tex->lru_next;
+	if (tex->lru_next != NULL) tex->lru_next->lru_prev = tex->lru_prev;
+	else ctx->lru_tail = tex->lru_prev;
+	tex->lru_prev = tex->lru_next = NULL;
+}
+static void LRU_PushFront(UIContext* ctx, UIElemTexture* tex) {
+	tex->lru_prev = NULL;
+	tex->lru_next = ctx->lru_head;
+	if (ctx->lru_head != NULL) ctx->lru_head->lru_prev = tex;
+	else ctx->lru_tail = tex;
+	ctx->lru_head = tex;
+}
+
+/// \brief Makes the pixels a resident texture of the context, takes the surface.
+static void Texture_Upload(UIContext* ctx, UIElemTexture* tex, SDL_Surface* pixels) {
+	if (pixels == NULL) return;
+
+	RGUI_LockRenderer(ctx->window);
+	tex->tex = PixelCache_Upload(ctx->window->renderer, pixels);
+	RGUI_UnlockRenderer(ctx->window);
+
+	if (tex->tex != NULL) {
+		tex->bytes = (Sint64)pixels->h * pixels->pitch;
+		ctx->texture_bytes += tex->bytes;
+		RG_TRACK(AllocTextures, tex->bytes);
+		LRU_PushFront(ctx, tex);
+	}
+	SDL_FreeSurface(pixels);
+}
+/// \brief Destroys the texture, the entry stays in the cache.
+static void Texture_Unload(UIContext* ctx, UIElemTexture* tex) {
+	if (tex->tex == NULL) return;
+	LRU_Remove(ctx, tex);
+	ctx->texture_bytes -= tex->bytes;
+	RG_TRACK(AllocTextures, -tex->bytes);
+	RGUI_DestroyTexture(ctx->window, tex->tex);
+	tex->tex = NULL;
+	tex->bytes = 0;
+}
+
+static void Texture_Release(UIElemTexture* tex) {
+	if (tex == NULL || --tex->refs > 0) return;
+	if (tex->ctx != NULL) {
+		UIElemTexture** link = &tex->ctx->textures[Texture_Bucket(tex->path)];
+		while (*link != tex) link = &(*link)->next;
+		*link = tex->next;
+		Texture_Unload(tex->ctx, tex);
+	}
+	// Freed by UIContext_FinishLoads when its pixels arrive
+	if (tex->loading) return;
+	RG_FREE(tex);
+}
+/// \brief The pixels of the image at the element's size in the format they are drawn fastest.
+static SDL_Surface* Texture_Pixels(char* path, Vec2 size, Uint32 native) {
+	SDL_Surface* pixels = PixelCache_Load(path);
+	if (pixels == NULL) return NULL;
+
+	if (size.X > 0 && size.Y > 0 && (pixels->w != size.X || pixels->h != size.Y)) {
+		SDL_Surface* scaled = Resample_Surface(pixels, size.X, size.Y);
+		SDL_FreeSurface(pixels);
+		if ((pixels = scaled) == NULL) return NULL;
+	}
+
+	// Translucent images stay ARGB for the blending
+	if (native != pixels->format->format && Resample_IsOpaque(pixels)) {
+		SDL_Surface* converted = SDL_ConvertSurfaceFormat(pixels, native, 0);
+		if (converted != NULL) {
+			SDL_FreeSurface(pixels);
+			pixels = converted;
+		}
+	}
+	return pixels;
+}
+/// \brief The texture of the image at the size from the cache, NULL if it isn't there.
+static UIElemTexture* Texture_Find(UIContext* ctx, char* path, Vec2 size) {
+	for (UIElemTexture* cached = ctx->textures[Texture_Bucket(path)]; cached != NULL; cached = cached->next) {
+		if (strcmp(cached->path, path) == 0 && Vec2_Compare(cached->size, size)) return cached;
+	}
+	return NULL;
+}
+/// \brief Puts the texture into the cache of the context, loaded or not.
+static void Texture_Cache(UIContext* ctx, UIElemTexture* tex) {
+	size_t bucket = Texture_Bucket(tex->path);
+	tex->ctx = ctx;
+	tex->next = ctx->textures[bucket];
+	ctx->textures[bucket] = tex;
+}
+static void Texture_Reload(UIContext* ctx, UIElemTexture* tex);
+/// \brief Loads the element's texture at its size, or replaces it with the same one from the cache.
+///
+/// \param later	Decoded on the loader thread, the color of the element is drawn until then.
+static void Texture_Load(UIContext* ctx, UIElem* uie, bool later) {
+	UIElemTexture* tex = uie->tex;
+	if (tex == NULL || tex->ctx != NULL) return;
+	tex->size = uie->size;
+
+	UIElemTexture* cached = Texture_Find(ctx, tex->path, tex->size);
+	if (cached != NULL) {
+		++cached->refs;
+		uie->tex = cached;
+		Texture_Release(tex);
+		return;
+	}
 
+	// Failed loads are cached too, so they aren't retried by every element
+	Texture_Cache(ctx, tex);
+	if (later) {
+		Texture_Reload(ctx, tex);
+	} else {
+		// Only the upload needs the renderer, the file is read without holding it
+		Texture_Upload(ctx, tex, Texture_Pixels(tex->path, tex->size, ctx->window->surface->format->format));
+	}
+}
 
-extern Uint32 _Mouse_X;
-extern Uint32 _Mouse_Y;
-extern Uint32 _Mouse_Btn;
+static void Load_Job(void* data) {
+	TextureLoad* load = data;
+	UIContext* ctx = load->ctx;
+	load->pixels = Texture_Pixels(load->path, load->size, load->native);
 
-extern RGWindow* RGUI_Current_Window;
+	SDL_AtomicLock(&ctx->loads_lock);
+	load->next = ctx->loaded;
+	ctx->loaded = load;
+	SDL_AtomicUnlock(&ctx->loads_lock);
+	SDL_AtomicAdd(&ctx->loads_pending, -1);
+}
+/// \brief Decodes an evicted or a resized texture on the loader thread, UIContext_FinishLoads uploads it.
+static void Texture_Reload(UIContext* ctx, UIElemTexture* tex) {
+	TextureLoad* load = RG_MALLOC(AllocTextures, sizeof(TextureLoad));
+	if (load == NULL) exit(MALLOC_FAILED);
+	load->tex = tex;
+	load->ctx = ctx;
+	strcpy(load->path, tex->path);
+	load->size = tex->size;
+	load->native = ctx->window->surface->format->format;
+	load->pixels = NULL;
 
-/// \brief The reference of the two previous elements the user interacted with.
+	tex->loading = true;
+	SDL_AtomicIncRef(&ctx->loads_pending);
+	Loader_Post(Load_Job, load);
+}
+/// \brief Marks the texture as drawn in this frame, reloads it if it was evicted.
+static void Texture_Touch(UIElemTexture* tex) {
+	UIContext* ctx = tex->ctx;
+	if (tex->tex != NULL) {
+		tex->last_drawn = ctx->frame;
+		if (ctx->lru_head != tex) {
+			LRU_Remove(ctx, tex);
+			LRU_PushFront(ctx, tex);
+		}
+	} else if (tex->evicted && !tex->loading) {
+		Texture_Reload(ctx, tex);
+	}
+}
+/// \brief Replaces the texture with the one of the element's size, loaded on the loader thread unless it's cached.
 ///
-/// Technically a QUEUE
-/// [0] = IN
-/// [1] = OUT
-UIElem *_State[2] = { NULL };
+/// The old texture is drawn stretched until the new one is uploaded, and an element
+/// waits for one size at a time, so animating the size doesn't decode the file in every frame.
+static void Texture_Resize(UIContext* ctx, UIElem* uie) {
+	UIElemTexture* next = uie->tex_next;
+	if (next != NULL) {
+		if (next->loading) return;
+		uie->tex_next = NULL;
+		// Failed loads are swapped in too, like Texture_Load keeps them
+		Texture_Release(uie->tex);
+		uie->tex = next;
+		if (Vec2_Compare(next->size, uie->size)) return;
+	}
+
+	UIElemTexture* old = uie->tex;
+	next = Texture_Find(ctx, old->path, uie->size);
+	if (next != NULL) {
+		++next->refs;
+	} else {
+		// Cached while it's loading, so the elements of the same size wait for the same one
+		next = Texture_New(old->path);
+		next->size = uie->size;
+		Texture_Cache(ctx, next);
+		Texture_Reload(ctx, next);
+	}
+
+	if (next->loading) {
+		uie->tex_next = next;
+	} else {
+		uie->tex = next;
+		Texture_Release(old);
+	}
+}
+
+void UIContext_SetTextureBudget(UIContext* ctx, Sint64 bytes) {
+	ctx->texture_budget = bytes;
+}
+void UIContext_FinishLoads(UIContext* ctx) {
+	SDL_AtomicLock(&ctx->loads_lock);
+	TextureLoad* load = ctx->loaded;
+	ctx->loaded = NULL;
+	SDL_AtomicUnlock(&ctx->loads_lock);
+
+	while (load != NULL) {
+		TextureLoad* next = load->next;
+		UIElemTexture* tex = load->tex;
+		tex->loading = false;
+
+		if (tex->refs <= 0) {
+			// Released while it was loading
+			if (load->pixels != NULL) SDL_FreeSurface(load->pixels);
+			RG_FREE(tex);
+		} else {
+			tex->evicted = false;
+			Texture_Upload(ctx, tex, load->pixels);
+			tex->last_drawn = ctx->frame;
+		}
+		RG_FREE(load);
+		load = next;
+	}
+}
+void UIContext_Evict(UIContext* ctx) {
+	if (ctx->texture_budget <= 0) return;
+
+	// The least recently drawn first, the ones on screen are never evicted
+	while (ctx->texture_bytes > ctx->texture_budget && ctx->lru_tail != NULL &&
+		ctx->lru_tail->last_drawn < ctx->frame) {
+		UIElemTexture* tex = ctx->lru_tail;
+		Texture_Unload(ctx, tex);
+		tex->evicted = true;
+	}
+}
+
+static void Callbacks_Release(UIElemCallbacks* cbs) {
+	if (cbs == NULL || --cbs->refs > 0) return;
+	for (size_t i = 0; i < N_CALLBACK_LISTS; ++i) {
+		EvLinkedListNode *current = cbs->lists[i], *to_del;
+		while(current != NULL) {
+			to_del = current;
+			current = current->next;
+			RG_FREE(to_del);
+		}
+	}
+	RG_FREE(cbs);
+}
+/// \brief Makes sure the element owns its callback set, copies it if it's shared.
+static UIElemCallbacks* Callbacks_Own(UIElem* uie) {
+	if (uie->callbacks != NULL && uie->callbacks->refs == 1) return uie->callbacks;
+
+	UIElemCallbacks* cbs = RG_MALLOC(AllocCallbacks, sizeof(UIElemCallbacks));
+	if (cbs == NULL) exit(MALLOC_FAILED);
+	cbs->refs = 1;
+
+	for (size_t i = 0; i < N_CALLBACK_LISTS; ++i) {
+		EvLinkedListNode **copy = &cbs->lists[i];
+		EvLinkedListNode *current = uie->callbacks != NULL ? uie->callbacks->lists[i] : NULL;
+		for (; current != NULL; current = current->next) {
+			*copy = RG_MALLOC(AllocCallbacks, sizeof(EvLinkedListNode));
+			if (*copy == NULL) exit(MALLOC_FAILED);
+			(*copy)->callback = current->callback;
+			copy = &(*copy)->next;
+		}
+		*copy = NULL;
+	}
+
+	Callbacks_Release(uie->callbacks);
+	return uie->callbacks = cbs;
+}
 
 /* Structure */
 
 UIElem* UIElem_Init(Vec2 position, Vec2 size, char *tex_path, Uint32 color, char* name) {
-	UIElem* uie = (UIElem*)malloc(sizeof(UIElem));
+	UIElem* uie = (UIElem*)RG_MALLOC(AllocTree, sizeof(UIElem));
 	if(uie == NULL) exit(MALLOC_FAILED);
-	if (tex_path != NULL) strcpy(uie->tex_path, tex_path);
-	else tex_path = "";
 
 	strcpy(uie->name, name);
 
@@ -33,57 +328,265 @@ UIElem* UIElem_Init(Vec2 position, Vec2 size, char *tex_path, Uint32 color, char
 	uie->abs_position = position;
 	uie->size = size;
 	uie->color = color;
-	uie->tex = NULL;
+	uie->file_color = color;
+	uie->tex = Texture_New(tex_path);
+	uie->tex_next = NULL;
+	uie->text = NULL;
+	uie->clip = true;
+	uie->from_rgml = false;
+	uie->parallel_tick = false;
+	uie->z = 0;
+	uie->z_pending = false;
+	uie->ctx = NULL;
+	uie->timers = NULL;
+	uie->tasks = NULL;
+	uie->version = NULL;
+	uie->handle = 0;
+	uie->pins = 0;
+	uie->deleted = false;
 
 	// #region Dynamically allocated things:
 	uie->parent = NULL;
 	uie->sibling = NULL;
 	uie->child = NULL;
 	uie->data = NULL;
-
-	for (size_t i = 0; i < N_CALLBACKS; i++) uie->callbacks[i] = NULL;
+	uie->data_size = 0;
+	uie->callbacks = NULL;
 	// #endregion
 
 	return uie;
 }
 
+/// \brief A copy of the element's payload if it can be copied, otherwise NULL.
+static void* Data_Copy(UIElem* uie) {
+	if (uie->data == NULL || uie->data_size == 0) return NULL;
+	void* data = RG_MALLOC(AllocTree, uie->data_size);
+	if (data == NULL) exit(MALLOC_FAILED);
+	memcpy(data, uie->data, uie->data_size);
+	return data;
+}
+/// \brief Copies the siblings from proto on, sharing their textures and callbacks.
+static UIElem* Instantiate_Helper(UIElem* proto, UIElem* parent) {
+	UIElem *first = NULL, **link = &first;
+	for (; proto != NULL; proto = proto->sibling) {
+		UIElem* uie = RG_MALLOC(AllocTree, sizeof(UIElem));
+		if (uie == NULL) exit(MALLOC_FAILED);
+
+		*uie = *proto;
+		if (uie->tex != NULL) ++uie->tex->refs;
+		uie->tex_next = NULL;
+		if (uie->callbacks != NULL) ++uie->callbacks->refs;
+		// data can't be shared, because it's freed with every element
+		uie->data = Data_Copy(proto);
+		uie->text = Text_Copy(proto->text);
+		uie->timers = NULL;
+		uie->tasks = NULL;
+		uie->version = NULL;
+		uie->handle = 0;
+		uie->pins = 0;
+		uie->deleted = false;
+		uie->z_pending = false;
+		uie->parallel_tick = false;
+		TickPool_SetParallel(uie, proto->parallel_tick);
+		uie->parent = parent;
+		uie->sibling = NULL;
+		uie->child = Instantiate_Helper(proto->child, uie);
+
+		*link = uie;
+		link = &uie->sibling;
+	}
+	return first;
+}
+UIElem* UIElem_Instantiate(UIElem* proto, Vec2 position, char* name) {
+	UIElem* uie = RG_MALLOC(AllocTree, sizeof(UIElem));
+	if (uie == NULL) exit(MALLOC_FAILED);
+
+	*uie = *proto;
+	strcpy(uie->name, name);
+	if (uie->tex != NULL) ++uie->tex->refs;
+	uie->tex_next = NULL;
+	if (uie->callbacks != NULL) ++uie->callbacks->refs;
+	uie->data = Data_Copy(proto);
+	uie->text = Text_Copy(proto->text);
+	uie->ctx = NULL;
+	uie->timers = NULL;
+	uie->tasks = NULL;
+	uie->version = NULL;
+	uie->handle = 0;
+	uie->pins = 0;
+	uie->deleted = false;
+	uie->z_pending = false;
+	uie->parallel_tick = false;
+	TickPool_SetParallel(uie, proto->parallel_tick);
+	uie->rel_position = position;
+	uie->parent = NULL;
+	uie->sibling = NULL;
+	uie->child = Instantiate_Helper(proto->child, uie);
+
+	UIElem_Update(uie);
+	return uie;
+}
+
+/// \brief Links child in front of the first child of parent not below it, keeping the order sorted by z.
+static void Link_Child(UIElem* parent, UIElem* child) {
+	UIElem** link = &parent->child;
+	// Usually every z is 0 and the child becomes the first
+	while (*link != NULL && (*link)->z < child->z) link = &(*link)->sibling;
+	child->sibling = *link;
+	*link = child;
+}
+/// \brief Unlinks child from the children of its parent.
+static void Unlink_Child(UIElem* child) {
+	UIElem** link = &child->parent->child;
+	while (*link != child) link = &(*link)->sibling;
+	*link = child->sibling;
+	child->sibling = NULL;
+}
 void UIElem_AddChild(UIElem* parent, UIElem* child) {
-	child->sibling = parent->child;
 	child->parent = parent;
-	parent->child = child;
+	child->z_pending = false;
+	Link_Child(parent, child);
 	UIElem_Update(child);
 }
+void UIElem_SetZ(UIElem* uie, int z) {
+	if (uie->z == z) return;
+	uie->z = z;
+	// Only the moved element is relinked, the order of the others stays
+	if (uie->parent == NULL) return;
+	UIContext* ctx = UIElem_Context(uie);
+	if (ctx != NULL && ctx->drawing) {
+		// Called by a Tick, the siblings may be being walked
+		if (!uie->z_pending) ++ctx->z_pending;
+		uie->z_pending = true;
+		return;
+	}
+	Unlink_Child(uie);
+	Link_Child(uie->parent, uie);
+}
+/// \brief Cuts the hover path of the window where it enters the subtree.
+static void Forget_Hover(UIElem* subtree) {
+	UIContext* ctx = UIElem_Context(subtree);
+	if (ctx == NULL) return;
+
+	for (int i = 0; i < ctx->path_len; ++i) {
+		if (ctx->path[i] == subtree) {
+			ctx->path_len = i;
+			ctx->hover = NULL;
+			break;
+		}
+	}
+	if (ctx->pressed == subtree || UIElem_IsParent(subtree, ctx->pressed)) ctx->pressed = NULL;
+	if (ctx->capture == subtree || UIElem_IsParent(subtree, ctx->capture)) ctx->capture = NULL;
+}
 void UIElem_RemoveFromParent(UIElem* child_to_remove) {
+	// The hover state must not point to detached (and maybe freed) elements
+	Forget_Hover(child_to_remove);
 	// If child_to_remove is the root just return
 	if(child_to_remove->parent == NULL) return;
-	// First child of the parent
-	UIElem* temp = child_to_remove->parent->child;
-
-	if (temp != child_to_remove) {
-		// If the first child isn't the element we want to delete...
-		// We find the previous child
-		while (temp->sibling != child_to_remove) temp = temp->sibling;
-		// and link that to the next sibling.
-		temp->sibling = child_to_remove->sibling;
-	} else {
-		// Else, just link the next sibling to the parent.
-		child_to_remove->parent->child = child_to_remove->sibling;
-	}
 
-	child_to_remove->sibling = NULL;
+	Unlink_Child(child_to_remove);
 	child_to_remove->parent = NULL;
 }
 
+/* Handles */
+
+typedef struct HandleSlot {
+	UIElem* uie;
+	/// \brief Incremented when the element is deleted, so the old handles don't resolve.
+	Uint32 generation;
+	/// \brief The next free slot + 1, 0 if it's the last one.
+	Uint32 next_free;
+} HandleSlot;
+
+/// \brief The slots of every window's elements, the windows can be driven from different threads.
+///
+/// Kept for the whole process, so the generations never restart while a handle may be held.
+static HandleSlot* _Slots = NULL;
+static Uint32 _Slot_Capacity = 0;
+static Uint32 _Free_Slot = 0;
+static SDL_SpinLock _Slot_Lock = 0;
+
+UIElemHandle UIElem_Handle(UIElem* uie) {
+	SDL_AtomicLock(&_Slot_Lock);
+	if (uie->handle == 0) {
+		if (_Free_Slot == 0) {
+			Uint32 capacity = _Slot_Capacity == 0 ? 64 : _Slot_Capacity * 2;
+			HandleSlot* slots = RG_MALLOC(AllocOther, capacity * sizeof(HandleSlot));
+			if (slots == NULL) exit(MALLOC_FAILED);
+			if (_Slots != NULL) {
+				memcpy(slots, _Slots, _Slot_Capacity * sizeof(HandleSlot));
+				RG_FREE(_Slots);
+			}
+			for (Uint32 i = _Slot_Capacity; i < capacity; ++i) {
+				slots[i].uie = NULL;
+				slots[i].generation = 0;
+				slots[i].next_free = i + 1 < capacity ? i + 2 : 0;
+			}
+			_Free_Slot = _Slot_Capacity + 1;
+			_Slots = slots;
+			_Slot_Capacity = capacity;
+		}
+		uie->handle = _Free_Slot;
+		HandleSlot* slot = &_Slots[_Free_Slot - 1];
+		_Free_Slot = slot->next_free;
+		slot->uie = uie;
+	}
+	UIElemHandle handle = (UIElemHandle)_Slots[uie->handle - 1].generation << 32 | uie->handle;
+	SDL_AtomicUnlock(&_Slot_Lock);
+	return handle;
+}
+
+UIElem* UIElem_Resolve(UIElemHandle handle) {
+	Uint32 index = (Uint32)handle;
+	UIElem* uie = NULL;
+	SDL_AtomicLock(&_Slot_Lock);
+	if (index != 0 && index <= _Slot_Capacity && _Slots[index - 1].generation == (Uint32)(handle >> 32)) {
+		uie = _Slots[index - 1].uie;
+	}
+	SDL_AtomicUnlock(&_Slot_Lock);
+	return uie;
+}
+
+/// \brief Invalidates the handle of a deleted element.
+static void Handle_Release(UIElem* uie) {
+	if (uie->handle == 0) return;
+	SDL_AtomicLock(&_Slot_Lock);
+	HandleSlot* slot = &_Slots[uie->handle - 1];
+	slot->uie = NULL;
+	++slot->generation;
+	slot->next_free = _Free_Slot;
+	_Free_Slot = uie->handle;
+	SDL_AtomicUnlock(&_Slot_Lock);
+}
+
 /// \brief Recursive delete.
 static void Delete_Helper(UIElem *uie) {
 	if(uie == NULL) return;
 	Delete_Helper(uie->sibling);
 	Delete_Helper(uie->child);
 
+	TickPool_SetParallel(uie, false);
+	Timer_StopAll(uie);
+	Task_CancelAll(uie);
 	UIElem_RemoveCallbacks(uie);
-	if(uie->data != NULL) free(uie->data);
-	if(uie->tex != NULL) SDL_DestroyTexture(uie->tex);
-	free(uie);
+	if(uie->data != NULL) RG_FREE(uie->data);
+	Texture_Release(uie->tex);
+	Texture_Release(uie->tex_next);
+	Text_Free(uie->text);
+	Handle_Release(uie);
+	if (uie->pins == 0) {
+		RG_FREE(uie);
+		return;
+	}
+	// A dispatch still walks it, the last one frees it
+	uie->deleted = true;
+	uie->tex = NULL;
+	uie->tex_next = NULL;
+	uie->text = NULL;
+	uie->data = NULL;
+	uie->parent = NULL;
+	uie->sibling = NULL;
+	uie->child = NULL;
 }
 void UIElem_Delete(UIElem *uie) {
 	UIElem_RemoveFromParent(uie);
@@ -92,6 +595,10 @@ void UIElem_Delete(UIElem *uie) {
 
 /* Utility */
 
+char* UIElem_TexPath(UIElem* uie) {
+	return uie->tex != NULL ? uie->tex->path : "";
+}
+
 inline Uint32 UIElem_Left(UIElem* uie)		{ return uie->abs_position.X; }
 inline Uint32 UIElem_Right(UIElem* uie)		{ return uie->abs_position.X + uie->size.X; }
 inline Uint32 UIElem_Top(UIElem* uie)		{ return uie->abs_position.Y; }
@@ -105,6 +612,10 @@ bool UIElem_IsParent(UIElem* parent, UIElem* child) {
 	}
 	return false;
 }
+UIContext* UIElem_Context(UIElem* uie) {
+	while (uie->parent != NULL) uie = uie->parent;
+	return uie->ctx;
+}
 UIElem* UIElem_FindElem(char* name, UIElem* current) {
 	if (current == NULL) return NULL;
 	if (strcmp(name, current->name) == 0) return current;
@@ -115,12 +626,31 @@ UIElem* UIElem_FindElem(char* name, UIElem* current) {
 	return UIElem_FindElem(name, current->sibling);
 }
 
-void UIElem_LoadTextures(UIElem* uie) {
+static void Load_Helper(UIContext* ctx, UIElem* uie, bool later) {
 	if (uie == NULL) return;
 
-	if(strlen(uie->tex_path) > 0) uie->tex = IMG_LoadTexture(RGUI_Current_Window->renderer, uie->tex_path);
-	UIElem_LoadTextures(uie->sibling);
-	UIElem_LoadTextures(uie->child);
+	// A shared texture is loaded only by its first element
+	Texture_Load(ctx, uie, later);
+	Load_Helper(ctx, uie->sibling, later);
+	Load_Helper(ctx, uie->child, later);
+}
+void UIElem_LoadTextures(UIContext* ctx, UIElem* uie) {
+	Load_Helper(ctx, uie, false);
+}
+void UIElem_LoadTexturesLater(UIContext* ctx, UIElem* uie) {
+	Load_Helper(ctx, uie, true);
+}
+void UIElem_SetTexture(UIContext* ctx, UIElem* uie, char* tex_path) {
+	UIElem_SetTexturePath(uie, tex_path);
+	Texture_Load(ctx, uie, false);
+}
+void UIElem_SetTexturePath(UIElem* uie, char* tex_path) {
+	// The path may belong to the old texture, so it's released last
+	UIElemTexture* old = uie->tex;
+	uie->tex = Texture_New(tex_path);
+	Texture_Release(old);
+	Texture_Release(uie->tex_next);
+	uie->tex_next = NULL;
 }
 /// \brief Recursive abs_position update for children.
 static void Update_Helper(UIElem* uie) {
@@ -145,35 +675,99 @@ void UIElem_Update(UIElem* uie) {
 	Update_Helper(uie->child);
 }
 
-/// \brief Renders the element and calls the Tick event.
-void UIElem_Draw(UIElem* uie) {
-	if (uie == NULL) return;
-	
-	UIElem_TriggerEvent(uie, Tick);
-
-	SDL_Rect rect = (SDL_Rect){
+static SDL_Rect Elem_Rect(UIElem* uie) {
+	return (SDL_Rect){
 		uie->abs_position.X, uie->abs_position.Y,
 		uie->size.X, uie->size.Y
 	};
-	if ((0x000000FF & uie->color) != 0x00000000) {
-		SDL_FillRect(
-			RGUI_Current_Window->surface,
-			&rect,
-			SDL_MapRGBA(
-				RGUI_Current_Window->surface->format,
-				uie->color >> 24,
-				uie->color >> 16,
-				uie->color >> 8,
-				uie->color
-			)
-		);
+}
+/// \brief Tells whether a descendant is drawn outside the rect, so the clip has to be recorded.
+///
+/// The children of the children which don't clip are drawn with this clip too, so they are checked as well.
+static bool Children_Overflow(UIElem* child, SDL_Rect* rect) {
+	for (; child != NULL; child = child->sibling) {
+		SDL_Rect r = Elem_Rect(child);
+		if (r.x < rect->x || r.y < rect->y ||
+			r.x + r.w > rect->x + rect->w || r.y + r.h > rect->y + rect->h) return true;
+		if (!child->clip && Children_Overflow(child->child, rect)) return true;
+	}
+	return false;
+}
+static void Draw_Helper(UIContext* ctx, UIElem* uie, Scene* scene, SDL_Rect* clip);
+/// \brief Records the element and its subtree, calls the Tick event, unless TickPool_Run calls it.
+///
+/// clip is the part of the window the element can be drawn on.
+static void Draw_Elem(UIContext* ctx, UIElem* uie, Scene* scene, SDL_Rect* clip) {
+	if (!uie->parallel_tick) UIElem_TriggerEvent(uie, Tick);
+
+	SDL_Rect rect = Elem_Rect(uie);
+	SDL_Rect visible;
+	bool shown = SDL_IntersectRect(&rect, clip, &visible);
+
+	if (shown) {
+		// Resized since it was loaded, the texture of the new size replaces it
+		if (uie->tex != NULL && uie->tex->ctx != NULL && !Vec2_Compare(uie->tex->size, uie->size)) {
+			Texture_Resize(uie->tex->ctx, uie);
+		}
+		if (uie->tex != NULL && uie->tex->ctx != NULL) Texture_Touch(uie->tex);
+
+		SDL_Texture* tex = uie->tex != NULL ? uie->tex->tex : NULL;
+		if ((0x000000FF & uie->color) != 0x00000000 || tex != NULL) {
+			Scene_Add(scene, SceneDraw, &rect, uie->color, tex);
+		}
+		if (uie->text != NULL && ctx != NULL) Text_Draw(ctx, uie, scene, &visible);
 	}
-	if (uie->tex != NULL) {
-		SDL_RenderCopy(RGUI_Current_Window->renderer, uie->tex, NULL, &rect);
+
+	if (uie->child == NULL) return;
+
+	if (!uie->clip) {
+		Draw_Helper(ctx, uie->child, scene, clip);
+	} else if (shown) {
+		// Children inside the element don't need the renderer's clip, only the culling
+		if (Children_Overflow(uie->child, &rect)) {
+			Scene_Add(scene, ScenePushClip, &rect, 0, NULL);
+			Draw_Helper(ctx, uie->child, scene, &visible);
+			Scene_Add(scene, ScenePopClip, &rect, 0, NULL);
+		} else {
+			Draw_Helper(ctx, uie->child, scene, &visible);
+		}
+	}
+	// Else the whole subtree is outside the clip
+}
+/// \brief Records the siblings from uie on, so the ones later in the order are on top.
+static void Draw_Helper(UIContext* ctx, UIElem* uie, Scene* scene, SDL_Rect* clip) {
+	for (; uie != NULL; uie = uie->sibling) {
+		Draw_Elem(ctx, uie, scene, clip);
+	}
+}
+/// \brief Relinks the elements whose z was changed while drawing.
+static void Relink_Pending(UIElem* uie) {
+	while (uie != NULL) {
+		UIElem* next = uie->sibling;
+		Relink_Pending(uie->child);
+		if (uie->z_pending) {
+			uie->z_pending = false;
+			Unlink_Child(uie);
+			Link_Child(uie->parent, uie);
+		}
+		uie = next;
 	}
+}
+void UIElem_Draw(UIElem* uie, Scene* scene) {
+	if (uie == NULL) return;
+	UIContext* ctx = UIElem_Context(uie);
+	SDL_Rect clip = Elem_Rect(uie);
+	// A tree which isn't in a window has no context
+	if (ctx != NULL) ctx->drawing = true;
+	Draw_Helper(ctx, uie, scene, &clip);
+	if (ctx == NULL) return;
+	ctx->drawing = false;
 
-	UIElem_Draw(uie->sibling);
-	UIElem_Draw(uie->child);
+	// The whole tree is walked only in the frames a Tick changed a z
+	if (ctx->z_pending > 0) {
+		ctx->z_pending = 0;
+		Relink_Pending(uie);
+	}
 }
 
 void UIElem_AddCallback(UIElem *root, char *name, EventType evt, UIElem_EventCallback callback) {
@@ -181,103 +775,361 @@ void UIElem_AddCallback(UIElem *root, char *name, EventType evt, UIElem_EventCal
 
 	if (uie == NULL) return;
 
-	EvLinkedListNode* new_cb = malloc(sizeof(EvLinkedListNode));
+	UIElemCallbacks* cbs = Callbacks_Own(uie);
+	EvLinkedListNode* new_cb = RG_MALLOC(AllocCallbacks, sizeof(EvLinkedListNode));
 	if (new_cb == NULL) exit(MALLOC_FAILED);
 
 	new_cb->callback = callback;
-	new_cb->next = uie->callbacks[evt];
-	uie->callbacks[evt] = new_cb;
+	new_cb->next = cbs->lists[evt];
+	cbs->lists[evt] = new_cb;
 }
 void UIElem_RemoveCallback(UIElem* root, char* name, EventType evt, UIElem_EventCallback callback) {
 	UIElem *uie = UIElem_FindElem(name, root);
-	if (uie == NULL) return;
+	if (uie == NULL || uie->callbacks == NULL) return;
 
-	EvLinkedListNode **ind = &(uie->callbacks[evt]);
+	EvLinkedListNode **ind = &(Callbacks_Own(uie)->lists[evt]);
 
-	while ((*ind)->callback != callback) {
-		if ((*ind)->next == NULL) return;
+	while (*ind != NULL && (*ind)->callback != callback) {
 		ind = &((*ind)->next);
 	}
-	
-	EvLinkedListNode *elem = (*ind)->next;
+	if (*ind == NULL) return;
+
+	EvLinkedListNode *elem = *ind;
 	*ind = elem->next;
-	free(elem);
+	RG_FREE(elem);
 }
 void UIElem_RemoveCallbacks(UIElem* uie) {
-	for (size_t i = 0; i < N_CALLBACKS; ++i) {
-		EvLinkedListNode *current = uie->callbacks[i], *to_del;
-		uie->callbacks[i] = NULL;
-		while(current != NULL) {
-			to_del = current;
-			current = current->next;
-			free(to_del);
-		}
-	}
+	Callbacks_Release(uie->callbacks);
+	uie->callbacks = NULL;
+}
+void UIElem_ReleaseCallbacks(UIElemCallbacks* cbs) {
+	Callbacks_Release(cbs);
 }
+#ifdef RGUI_TRACE
+static const char* _Event_Names[N_CALLBACKS] = {
+	"MouseEnter", "MouseLeave", "MouseHover", "LMBDown", "LMBUp", "Scroll", "Drag", "Drop", "Tick"
+};
+#endif
 void UIElem_TriggerEvent(UIElem* uie, EventType evt) {
-	if (uie == NULL) return;
-	EvLinkedListNode *elln = uie->callbacks[evt];
+	if (uie == NULL || uie->callbacks == NULL) return;
+	EvLinkedListNode *elln = uie->callbacks->lists[evt];
+	if (elln == NULL) return;
+
+	TRACE_BEGIN(trace_begin);
 	while (elln != NULL) {
 		elln->callback(uie);
 		elln = elln->next;
 	}
+	TRACE_END(trace_begin, _Event_Names[evt % N_CALLBACKS], uie->name);
 }
 
-static void EventHelper(UIElem* uie, EventType evt) {
-	if (uie == NULL) return;
-	UIElem_TriggerEvent(uie, evt);
-	EventHelper(uie->parent, evt);
+void UIContext_Init(UIContext* ctx, struct RGWindow* window) {
+	ctx->window = window;
+	ctx->atlases = NULL;
+	for (int i = 0; i < UI_TEXTURE_BUCKETS; ++i) ctx->textures[i] = NULL;
+	ctx->lru_head = ctx->lru_tail = NULL;
+	ctx->texture_bytes = 0;
+	ctx->texture_budget = 0;
+	ctx->frame = 0;
+	ctx->loaded = NULL;
+	ctx->loads_lock = 0;
+	SDL_AtomicSet(&ctx->loads_pending, 0);
+	ctx->mouse_x = ctx->mouse_y = 0;
+	ctx->mouse_buttons = 0;
+	ctx->wheel_y = 0;
+	ctx->mouse_in = false;
+	ctx->hover = NULL;
+	ctx->path = NULL;
+	ctx->path_len = 0;
+	ctx->path_capacity = 0;
+	ctx->pressed = NULL;
+	ctx->press_timestamp = 0;
+	ctx->capture = NULL;
+	ctx->drawing = false;
+	ctx->z_pending = 0;
 }
-static void Event_MouseEnter(void) {
-	UIElem_TriggerEvent(_State[0], MouseEnter);
+void UIContext_Free(UIContext* ctx) {
+	while (SDL_AtomicGet(&ctx->loads_pending) > 0) SDL_Delay(1);
+	UIContext_FinishLoads(ctx);
+	Text_FreeAtlases(ctx);
+	RG_FREE(ctx->path);
+	ctx->path = NULL;
+	ctx->path_len = ctx->path_capacity = 0;
 }
-static void Event_MouseLeave(void) {
-	UIElem_TriggerEvent(_State[1], MouseLeave);
-}
-void Event_LMBUp(void) {
-	EventHelper(_State[0], LMBUp);
+
+/// \brief Makes room for needed elements in the path, keeping the first len.
+static void Path_Reserve(UIElem*** path, int* capacity, int len, int needed) {
+	if (needed <= *capacity) return;
+
+	int new_capacity = *capacity == 0 ? 16 : *capacity;
+	while (new_capacity < needed) new_capacity *= 2;
+	UIElem** new_path = RG_MALLOC(AllocOther, new_capacity * sizeof(UIElem*));
+	if (new_path == NULL) exit(MALLOC_FAILED);
+	if (*path != NULL) {
+		memcpy(new_path, *path, len * sizeof(UIElem*));
+		RG_FREE(*path);
+	}
+	*path = new_path;
+	*capacity = new_capacity;
 }
 
-bool UIElem_MouseInside(UIElem* uie) {
-	if (!(UIElem_Top(uie) <= _Mouse_Y && UIElem_Bottom(uie) >= _Mouse_Y &&
-		UIElem_Left(uie) <= _Mouse_X && UIElem_Right(uie) >= _Mouse_X )) {
-		return false;
+/// \brief Sends MouseLeave to the hovered elements from depth down, deepest first.
+static void Hover_Leave(UIContext* ctx, int depth) {
+	while (ctx->path_len > depth) {
+		UIElem_TriggerEvent(ctx->path[--ctx->path_len], MouseLeave);
 	}
+}
+/// \brief Puts uie at depth of the hover path, leaving the old one there first if it differs.
+static void Hover_Enter(UIContext* ctx, UIElem* uie, int depth) {
+	// The ancestors are on the path already, so path_len >= depth
+	if (depth < ctx->path_len && ctx->path[depth] == uie) return;
+	Hover_Leave(ctx, depth);
 
+	Path_Reserve(&ctx->path, &ctx->path_capacity, ctx->path_len, ctx->path_len + 1);
+	ctx->path[ctx->path_len++] = uie;
+	UIElem_TriggerEvent(uie, MouseEnter);
+}
+
+static bool Mouse_Over(UIContext* ctx, UIElem* uie) {
+	Sint64 x = ctx->mouse_x, y = ctx->mouse_y;
+	return UIElem_Top(uie) <= y && UIElem_Bottom(uie) >= y &&
+		UIElem_Left(uie) <= x && UIElem_Right(uie) >= x;
+}
+/// \brief Only the elements the mouse is inside are descended into, so they all end up on the path.
+static bool MouseInside_Helper(UIContext* ctx, UIElem* uie, int depth) {
+	if (!Mouse_Over(ctx, uie)) return false;
+
+	Hover_Enter(ctx, uie, depth);
 	UIElem_TriggerEvent(uie, MouseHover);
 
-	// If mouse is inside a child
-	bool flag = true;
-	UIElem* child = uie->child;
-	while (child != NULL) {
-		if (!UIElem_MouseInside(child)) {
-			child = child->sibling;
-		} else {
-			flag = false;
-			break;
-		}
+	// If mouse is inside a child, the last one in the paint order is the topmost
+	UIElem* top = NULL;
+	for (UIElem* child = uie->child; child != NULL; child = child->sibling) {
+		if (Mouse_Over(ctx, child)) top = child;
 	}
+	if (top != NULL) return MouseInside_Helper(ctx, top, depth + 1);
 
-	if (flag && _State[0] != uie) { // THIS is _State[0]
-		_State[1] = _State[0];
-		_State[0] = uie;
+	// THIS is the hovered element, what was hovered below it is left
+	Hover_Leave(ctx, depth + 1);
+	ctx->hover = uie;
+	return true;
+}
+bool UIElem_MouseInside(UIContext* ctx, UIElem* root) {
+	if (ctx->mouse_in && MouseInside_Helper(ctx, root, 0)) return true;
 
-		// If prev element was a child
-		if (UIElem_IsParent(uie, _State[1])) {
-			Event_MouseLeave();
-		
-		// If prev element was a parent
-		} else if (UIElem_IsParent(_State[1], uie)) {
-			Event_MouseEnter();
+	Hover_Leave(ctx, 0);
+	ctx->hover = NULL;
+	return false;
+}
 
-		// If prev element has nothing to do with the current
-		} else {
-			////////////////////////MouseLeave til common parent
-			Event_MouseEnter();
-			Event_MouseLeave();
-			// MAYBE THIS CAN BE REMOVED
+/* Dispatch */
+
+#ifdef _MSC_VER
+#define EVENT_THREAD_LOCAL __declspec(thread)
+#else
+#define EVENT_THREAD_LOCAL _Thread_local
+#endif
+
+/// \brief The event being dispatched on this thread.
+static EVENT_THREAD_LOCAL UIEvent* _Event = NULL;
+
+UIEvent* UIEvent_Current(void) {
+	return _Event;
+}
+void UIEvent_StopPropagation(void) {
+	if (_Event != NULL) _Event->stopped = true;
+}
+void UIEvent_CapturePointer(void) {
+	if (_Event == NULL || _Event->ctx->pressed == NULL) return;
+	_Event->ctx->capture = _Event->current;
+}
+
+/// \brief The depth of the paths a dispatch keeps on the stack, deeper ones are allocated.
+#define EVENT_PATH_STACK 32
+
+/// \brief Keeps the memory of a deleted element until Unpin.
+static void Pin(UIElem* uie) {
+	++uie->pins;
+}
+static void Unpin(UIElem* uie) {
+	if (--uie->pins == 0 && uie->deleted) RG_FREE(uie);
+}
+
+/// \brief The length of the event path from the root to the target.
+static int Event_PathLength(UIContext* ctx, UIElem* target) {
+	if (target == ctx->hover) return ctx->path_len;
+	int len = 0;
+	for (UIElem* uie = target; uie != NULL; uie = uie->parent) ++len;
+	return len;
+}
+/// \brief Fills the event path, taken from the hover path when the target is the hovered one.
+static void Event_Path(UIContext* ctx, UIElem* target, UIElem** path, int len) {
+	if (target == ctx->hover) {
+		memcpy(path, ctx->path, len * sizeof(UIElem*));
+		return;
+	}
+	for (UIElem* uie = target; uie != NULL; uie = uie->parent) path[--len] = uie;
+}
+
+/// \brief UIElem_TriggerEvent for a pinned element, the callbacks stop once one deletes it.
+static void Trigger_Pinned(UIElem* uie, EventType evt) {
+	UIElemCallbacks* cbs = uie->callbacks;
+	if (uie->deleted || cbs == NULL || cbs->lists[evt] == NULL) return;
+
+	// Referenced, so a callback changing or removing the set copies it instead of freeing the list
+	++cbs->refs;
+	TRACE_BEGIN(trace_begin);
+	for (EvLinkedListNode* elln = cbs->lists[evt]; elln != NULL && !uie->deleted; elln = elln->next) {
+		elln->callback(uie);
+	}
+	TRACE_END(trace_begin, _Event_Names[evt % N_CALLBACKS], uie->name);
+	Callbacks_Release(cbs);
+}
+
+static void Dispatch(UIContext* ctx, UIEvent* event) {
+	if (event->target == NULL) return;
+
+	// Computed once and pinned, the callbacks may change the hierarchy and delete
+	// elements while it's walked, and a nested dispatch has its own path
+	UIElem* stack_path[EVENT_PATH_STACK];
+	UIElem** path = stack_path;
+	int len = Event_PathLength(ctx, event->target);
+	if (len > EVENT_PATH_STACK) {
+		path = RG_MALLOC(AllocOther, len * sizeof(UIElem*));
+		if (path == NULL) exit(MALLOC_FAILED);
+	}
+	Event_Path(ctx, event->target, path, len);
+	for (int i = 0; i < len; ++i) Pin(path[i]);
+
+	UIElem* target = path[len - 1];
+	EventType evt = event->type;
+	UIEvent* outer = _Event;
+	_Event = event;
+
+	event->phase = PhaseCapture;
+	for (int i = 0; i < len - 1 && !event->stopped; ++i) {
+		event->current = path[i];
+		Trigger_Pinned(path[i], CAPTURE(evt));
+	}
+	if (!event->stopped) {
+		event->phase = PhaseTarget;
+		event->current = target;
+		Trigger_Pinned(target, CAPTURE(evt));
+		if (!event->stopped) Trigger_Pinned(target, evt);
+	}
+	event->phase = PhaseBubble;
+	for (int i = len - 2; i >= 0 && !event->stopped; --i) {
+		event->current = path[i];
+		Trigger_Pinned(path[i], evt);
+	}
+
+	_Event = outer;
+	for (int i = 0; i < len; ++i) Unpin(path[i]);
+	if (path != stack_path) RG_FREE(path);
+}
+
+void UIElem_Dispatch(UIContext* ctx, const SDL_Event* sdl_event) {
+	// The pointer state of the window, only from its own events
+	switch (sdl_event->type) {
+	case SDL_MOUSEMOTION:
+		ctx->mouse_x = sdl_event->motion.x;
+		ctx->mouse_y = sdl_event->motion.y;
+		ctx->mouse_buttons = sdl_event->motion.state;
+		ctx->mouse_in = true;
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+	case SDL_MOUSEBUTTONUP:
+		ctx->mouse_x = sdl_event->button.x;
+		ctx->mouse_y = sdl_event->button.y;
+		if (sdl_event->type == SDL_MOUSEBUTTONDOWN) ctx->mouse_buttons |= SDL_BUTTON(sdl_event->button.button);
+		else ctx->mouse_buttons &= ~SDL_BUTTON(sdl_event->button.button);
+		break;
+	case SDL_MOUSEWHEEL:
+		ctx->wheel_y = sdl_event->wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -sdl_event->wheel.y : sdl_event->wheel.y;
+		break;
+	case SDL_WINDOWEVENT:
+		if (sdl_event->window.event == SDL_WINDOWEVENT_ENTER) ctx->mouse_in = true;
+		else if (sdl_event->window.event == SDL_WINDOWEVENT_LEAVE) ctx->mouse_in = false;
+		return;
+	}
+
+	UIEvent event = { 0 };
+	event.ctx = ctx;
+	event.timestamp = sdl_event->common.timestamp;
+	event.buttons = ctx->mouse_buttons;
+	event.x = ctx->mouse_x;
+	event.y = ctx->mouse_y;
+
+	switch (sdl_event->type) {
+	case SDL_MOUSEBUTTONDOWN:
+		if (sdl_event->button.button != SDL_BUTTON_LEFT) return;
+		ctx->pressed = ctx->hover;
+		ctx->press_timestamp = event.timestamp;
+
+		event.type = LMBDown;
+		event.target = ctx->hover;
+		event.button = SDL_BUTTON_LEFT;
+		event.buttons |= SDL_BUTTON_LMASK;
+		event.x = sdl_event->button.x;
+		event.y = sdl_event->button.y;
+		event.press_timestamp = ctx->press_timestamp;
+		Dispatch(ctx, &event);
+		break;
+
+	case SDL_MOUSEMOTION:
+		if (ctx->capture == NULL || !(sdl_event->motion.state & SDL_BUTTON_LMASK)) return;
+
+		event.type = Drag;
+		event.target = ctx->capture;
+		event.buttons = sdl_event->motion.state;
+		event.x = sdl_event->motion.x;
+		event.y = sdl_event->motion.y;
+		event.press_timestamp = ctx->press_timestamp;
+		Dispatch(ctx, &event);
+		break;
+
+	case SDL_MOUSEBUTTONUP: {
+		if (sdl_event->button.button != SDL_BUTTON_LEFT) return;
+		// A press outside the window or on an already deleted element is ignored
+		UIElem* pressed = ctx->pressed;
+		UIElem* dragged = ctx->capture;
+		ctx->pressed = ctx->capture = NULL;
+		if (pressed == NULL && dragged == NULL) return;
+
+		event.button = SDL_BUTTON_LEFT;
+		event.buttons &= ~SDL_BUTTON_LMASK;
+		event.x = sdl_event->button.x;
+		event.y = sdl_event->button.y;
+		event.press_timestamp = ctx->press_timestamp;
+
+		if (dragged != NULL) {
+			// The LMBUp callbacks may delete it
+			Pin(dragged);
+			event.type = LMBUp;
+			event.target = dragged;
+			Dispatch(ctx, &event);
+
+			// The hierarchy may have changed, the dragged element is only passed along
+			event.type = Drop;
+			event.target = ctx->hover;
+			event.related = dragged->deleted ? NULL : dragged;
+			event.stopped = false;
+			Dispatch(ctx, &event);
+			Unpin(dragged);
+		} else if (pressed == ctx->hover) {
+			event.type = LMBUp;
+			event.target = pressed;
+			Dispatch(ctx, &event);
 		}
+		break;
 	}
 
-	return true;
+	case SDL_MOUSEWHEEL:
+		event.type = Scroll;
+		event.target = ctx->capture != NULL ? ctx->capture : ctx->hover;
+		event.wheel_y = ctx->wheel_y;
+		event.press_timestamp = ctx->pressed != NULL ? ctx->press_timestamp : 0;
+		Dispatch(ctx, &event);
+		break;
+	}
 }
@@ -4,6 +4,7 @@
 
 #include "Error.h"
 #include "structs.h"
+#include "Scene.h"
 
 #ifndef UI_ELEM_H
 #define UI_ELEM_H
@@ -20,11 +21,19 @@ typedef enum EventType {
 	Scroll = 5,
 	Drag = 6,
 	Drop = 7,
-	/// \brief Called with every Draw
+	/// \brief Called once per frame, by UIElem_Draw or for the parallel_tick elements by TickPool_Run.
+	///
+	/// Both skip the same elements: the subtree of a clipping element outside
+	/// the visible part of its parent is culled, the element itself still gets it.
+	/// TickPool_Run culls with the positions before the parallel moves of the frame.
 	Tick = 8
 } EventType;
 /// \brief The number of EventTypes
 #define N_CALLBACKS 9
+/// \brief The list of the capture phase callbacks of an event, for UIElem_AddCallback and UIElem_RemoveCallback.
+#define CAPTURE(evt) ((EventType)((evt) + N_CALLBACKS))
+/// \brief The number of callback lists, for the bubble and the capture phase.
+#define N_CALLBACK_LISTS (2 * N_CALLBACKS)
 
 /// \brief Defines the type UIElem_EventCallback which can be any function with one UIElem* parameter
 typedef void (*UIElem_EventCallback)(struct UIElem*);
@@ -34,22 +43,155 @@ typedef struct EvLinkedListNode {
 	struct EvLinkedListNode* next;
 } EvLinkedListNode;
 
+/// \brief The callback lists of an element, shared between the instances of a template.
+///
+/// Copied on write, when a callback is added to or removed from a shared set.
+typedef struct UIElemCallbacks {
+	EvLinkedListNode *lists[N_CALLBACK_LISTS];
+	/// \brief The number of elements using the set.
+	int refs;
+} UIElemCallbacks;
+
+/// \brief A texture and its path, shared between the instances of a template.
+///
+/// Once loaded it's in the texture cache of a window, so it's shared by every
+/// element of the window with the same path and size. It's resampled to that
+/// size and, if it's opaque, converted to the window's pixel format,
+/// so drawing it is a straight copy.
+typedef struct UIElemTexture {
+	/// \brief The path to the texture.
+	char path[51];
+	/// \brief The size the image was resampled to, {0, 0} until it's loaded.
+	Vec2 size;
+	/// \brief Loaded by UIElem_LoadTextures, NULL until then.
+	SDL_Texture *tex;
+	/// \brief The number of elements using the texture.
+	int refs;
+	/// \brief The context of the window whose cache it's in, NULL until it's loaded.
+	struct UIContext *ctx;
+	/// \brief The next texture in the same bucket of the cache.
+	struct UIElemTexture *next;
+	/// \brief The memory of the pixels, 0 if it isn't resident.
+	Sint64 bytes;
+	/// \brief The UIContext.frame it was last drawn in.
+	Uint64 last_drawn;
+	/// \brief The resident textures of the context, the most recently drawn first.
+	struct UIElemTexture *lru_prev, *lru_next;
+	/// \brief Unloaded to keep the budget, reloaded when it's drawn again.
+	bool evicted;
+	/// \brief Being decoded on the loader thread.
+	bool loading;
+} UIElemTexture;
+
+#define UI_TEXTURE_BUCKETS 64
+
+/// \brief The per-window state of a tree, passed explicitly so windows don't share anything.
+typedef struct UIContext {
+	/// \brief The window owning the tree, textures are loaded with its renderer.
+	struct RGWindow *window;
+	/// \brief The glyph atlases of the text elements, one per font and size.
+	struct GlyphAtlas *atlases;
+	/// \brief The loaded textures of the window, hashed by path.
+	UIElemTexture *textures[UI_TEXTURE_BUCKETS];
+	/// \brief The resident textures, the least recently drawn is evicted first.
+	UIElemTexture *lru_head, *lru_tail;
+	/// \brief The memory of the resident textures.
+	Sint64 texture_bytes;
+	/// \brief The most texture_bytes kept after drawing a frame, 0 for no limit.
+	Sint64 texture_budget;
+	/// \brief The number of the frame being drawn.
+	Uint64 frame;
+	/// \brief The reloads decoded by the loader thread, guarded by loads_lock.
+	struct TextureLoad *loaded;
+	SDL_SpinLock loads_lock;
+	/// \brief The reloads posted to the loader thread and not decoded yet.
+	SDL_atomic_t loads_pending;
+	/// \brief The pointer in the window, set from the window's own events by UIElem_Dispatch.
+	Sint32 mouse_x, mouse_y;
+	/// \brief The held buttons (SDL_BUTTON_LMASK...).
+	Uint32 mouse_buttons;
+	/// \brief The movement of the last wheel event, positive away from the user.
+	Sint32 wheel_y;
+	/// \brief The pointer is over the window, nothing is hovered otherwise.
+	bool mouse_in;
+	/// \brief The element under the mouse, the deepest one of path.
+	struct UIElem *hover;
+	/// \brief The hovered element and its ancestors from the root, these got MouseEnter but no MouseLeave yet.
+	struct UIElem **path;
+	int path_len;
+	int path_capacity;
+	/// \brief The element the left button was pressed on, NULL if it isn't held.
+	struct UIElem *pressed;
+	/// \brief SDL timestamp of the press.
+	Uint32 press_timestamp;
+	/// \brief The element getting the pointer events until the left button is released, NULL if none.
+	struct UIElem *capture;
+	/// \brief UIElem_Draw is walking the tree, UIElem_SetZ only marks the elements meanwhile.
+	bool drawing;
+	/// \brief The elements marked by UIElem_SetZ while drawing, relinked at the end of UIElem_Draw.
+	int z_pending;
+} UIContext;
+
+typedef enum EventPhase {
+	/// \brief From the root down to the parent of the target, CAPTURE(evt) callbacks.
+	PhaseCapture,
+	/// \brief The target itself, CAPTURE(evt) then evt callbacks.
+	PhaseTarget,
+	/// \brief From the parent of the target up to the root, evt callbacks.
+	PhaseBubble
+} EventPhase;
+
+/// \brief The pointer event being dispatched, the callbacks get it with UIEvent_Current.
+typedef struct UIEvent {
+	/// \brief LMBDown, LMBUp, Scroll, Drag or Drop.
+	EventType type;
+	EventPhase phase;
+	/// \brief The deepest element of the propagation path.
+	struct UIElem *target;
+	/// \brief The element whose callbacks are running.
+	struct UIElem *current;
+	/// \brief For Drop the dragged element (which had the pointer capture), NULL otherwise.
+	struct UIElem *related;
+	/// \brief The mouse position in the window.
+	Sint32 x, y;
+	/// \brief The button which changed (SDL_BUTTON_LEFT), 0 if none did.
+	Uint8 button;
+	/// \brief The held buttons (SDL_BUTTON_LMASK...).
+	Uint32 buttons;
+	/// \brief The wheel movement of Scroll, positive away from the user.
+	Sint32 wheel_y;
+	/// \brief SDL timestamp of the event.
+	Uint32 timestamp;
+	/// \brief SDL timestamp of the press the event belongs to, 0 if the button isn't held.
+	Uint32 press_timestamp;
+	/// \brief Set by UIEvent_StopPropagation.
+	bool stopped;
+	UIContext *ctx;
+} UIEvent;
+
 
 /****************************************************************************************************/
 /// \brief Function prototype should apply default callbacks and process the UIElem.data field
+///
+/// A payload which can be copied should have its size in UIElem.data_size.
 typedef void (*UIElem_Builder)(struct UIElem*);
 /****************************************************************************************************/
 
 
+/// \brief Refers to an element without touching its memory, 0 refers to none.
+///
+/// The slot of the element and its generation, a deleted element's handle
+/// resolves to NULL even if its memory was reused.
+typedef Uint64 UIElemHandle;
+
 /// \brief The struct at the backbone of the UI.
 ///
 /// These structs are linked together into a hierarchical tree structure
 /// to handle events.
 ///
-/// The locations and sizes of siblings should not overlap,
-/// because I knew that in the project no elements will overlap,
-/// when the mouse_inside() finds the first element your cursor is on,
-/// no more effort will be made to find other elements.
+/// Siblings can overlap, the children are linked in paint order sorted by z
+/// (among equal z the one added later is painted first), and the mouse is
+/// inside the topmost of the siblings under the cursor.
 ///
 /// Events just like in the HTML DOM with JS apply for parents
 /// (except mouse_enter and mouse_leave).
@@ -64,13 +206,50 @@ typedef struct UIElem {
 	///
 	/// position.X + size.X <= parent->size.X
 	Vec2 size;
-	/// \brief The path to the texture.
-	char tex_path[51];
 
 	/// \brief The default backgound color.
 	Uint32 color;
-	/// \brief The texture of the element (background image).
-	SDL_Texture *tex;
+	/// \brief The texture of the element (background image), NULL if there is none.
+	///
+	/// Can be shared, use UIElem_SetTexture to change it.
+	UIElemTexture *tex;
+	/// \brief The texture at the element's new size while it's being loaded, NULL if there is none.
+	UIElemTexture *tex_next;
+	/// \brief The text drawn over the background, NULL if there is none.
+	///
+	/// Set it with Text_Init or the "text" builder, change it with Text_Set.
+	struct UIElemText *text;
+	/// \brief If true (the default) the children are only drawn inside the bounds of the element.
+	///
+	/// Then the whole subtree is skipped when the element is outside the clip of its parent.
+	/// If false the children can overflow, and they are clipped with the parent's clip.
+	bool clip;
+	/// \brief Created from the .rgml file, only these are touched by RGUI_Reload.
+	bool from_rgml;
+	/// \brief The color in the file when it was last parsed, RGUI_Reload applies the changes of it.
+	Uint32 file_color;
+	/// \brief The context of the window, only set on the root of a window's tree.
+	UIContext *ctx;
+	/// \brief The timers started on the element, stopped when it's deleted.
+	struct Timer *timers;
+	/// \brief The tasks owned by the element, cancelled when it's deleted.
+	struct Task *tasks;
+	/// \brief The current version of the element in its History, NULL if it isn't tracked.
+	struct HistoryNode *version;
+	/// \brief The stacking order among the siblings, higher is painted later (on top), set it with UIElem_SetZ.
+	int z;
+	/// \brief The z changed while the tree was drawn, the element is relinked after it.
+	bool z_pending;
+	/// \brief The Tick callbacks run in TickPool_Run instead of UIElem_Draw, set it with TickPool_SetParallel.
+	bool parallel_tick;
+	/// \brief The slot of the element's handle + 1, 0 until UIElem_Handle is called.
+	Uint32 handle;
+	/// \brief The dispatches whose propagation path holds the element.
+	///
+	/// While it isn't 0, a deleted element only releases its resources and is
+	/// marked deleted, the memory is freed when the last of these dispatches ends.
+	int pins;
+	bool deleted;
 
 	/// \brief The parent in the hierarchy.
 	struct UIElem *parent;
@@ -78,13 +257,22 @@ typedef struct UIElem {
 	struct UIElem *sibling;
 	/// \brief The first child of the parent.
 	struct UIElem *child;
-	/// \brief The functions of the UIElem.
+	/// \brief The functions of the UIElem, NULL if there are none.
 	///
 	/// eg. translate the UIElem vertically when scrolled:<br>
 	/// UIElem_AddCallback(window, "that_red_x", Click, exit);
-	EvLinkedListNode *callbacks[N_CALLBACKS];
+	///
+	/// Can be shared, use UIElem_AddCallback and UIElem_RemoveCallback to change it.
+	UIElemCallbacks *callbacks;
 	/// \brief For storing arbitrary data, will be freed on delete.
+	///
+	/// Should be allocated with RG_MALLOC(AllocTree, size).
 	void *data;
+	/// \brief The size of data if it's a plain block which can be copied, eg. the payload of a builder.
+	///
+	/// Then the copies of the element (the instances of a template) get a copy of it,
+	/// 0 if data holds pointers or can't be copied for another reason.
+	size_t data_size;
 } UIElem;
 
 
@@ -96,8 +284,24 @@ typedef struct UIElem {
 /// \param color	The default background color, if the alpha is 0x00 it will be ignored.
 /// \param name		The reference name for adding callbacks, MAX 20 character.
 UIElem* UIElem_Init(Vec2 position, Vec2 size, char* tex_path, Uint32 color, char* name);
-/// \brief Adds a child to the children linked list.
+/// \brief Creates an instance of a template, a copy of its subtree.
+///
+/// The copies share the textures and the callbacks of the template elements,
+/// only the position, size, color and the tree links are stored per element.
+/// The payloads with a data_size are copied, the others aren't.
+///
+/// \param proto		The root of the template.
+/// \param position	Relative position to parent.
+/// \param name		The name of the instance's root, MAX 20 character.
+UIElem* UIElem_Instantiate(UIElem* proto, Vec2 position, char* name);
+/// \brief Adds a child to the children linked list, before the siblings with the same z.
 void UIElem_AddChild(UIElem* parent, UIElem* child);
+/// \brief Changes the z of the element, moving it in the paint order of its siblings if it changed.
+///
+/// Not from a parallel Tick, the siblings are relinked. From a serial Tick (while
+/// UIElem_Draw walks the siblings) the element is relinked after the frame is recorded,
+/// so the new order shows from the next frame.
+void UIElem_SetZ(UIElem* uie, int z);
 /// \brief Removes the child from the children linked list.
 void UIElem_RemoveFromParent(UIElem *child);
 /// \brief Frees up the UIElem and its children
@@ -114,18 +318,42 @@ extern inline Uint32 UIElem_Top(UIElem* uie);
 /// \brief the (Y) coordinate of the element's bottom side.
 extern inline Uint32 UIElem_Bottom(UIElem* uie);
 
+/// \brief The path of the element's texture, "" if there is none.
+char* UIElem_TexPath(UIElem* uie);
 /// \brief Tells whether the "parent" is above the "child" in the hierarchy.
 bool UIElem_IsParent(UIElem* parent, UIElem* child);
 /// \brief Finds an element with the given name in a tree.
 UIElem* UIElem_FindElem(char* name, UIElem* root);
+/// \brief The context of the window the element is in, NULL if it isn't in one.
+UIContext* UIElem_Context(UIElem* uie);
+/// \brief The handle of the element, eg. for posting commands from other threads.
+///
+/// Should be taken on the thread owning the element, the handle can be used anywhere.
+UIElemHandle UIElem_Handle(UIElem* uie);
+/// \brief The element of the handle, NULL if it was deleted since.
+///
+/// The element can only be used on the thread owning it.
+UIElem* UIElem_Resolve(UIElemHandle handle);
 
 /* Draw & Update */
-/// \brief Load the textures from the files.
-void UIElem_LoadTextures(UIElem* root);
+/// \brief Loads the textures from the files or takes them from the window's cache.
+void UIElem_LoadTextures(UIContext* ctx, UIElem* root);
+/// \brief Like UIElem_LoadTextures, but the files are decoded on the loader thread.
+///
+/// The missing textures are uploaded by UIContext_FinishLoads, the colors are drawn until then.
+void UIElem_LoadTexturesLater(UIContext* ctx, UIElem* root);
+/// \brief Replaces the texture of the element, loaded into the window of ctx.
+void UIElem_SetTexture(UIContext* ctx, UIElem* uie, char* tex_path);
+/// \brief Replaces the texture of the element without loading it, UIElem_LoadTextures will.
+void UIElem_SetTexturePath(UIElem* uie, char* tex_path);
 /// \brief Updates computed properties of the element and the children such as abs_position.
 void UIElem_Update(UIElem* uie);
-/// \brief Draws the UI_Elem on the screen.
-void UIElem_Draw(UIElem* uie);
+/// \brief Calls the Tick events and records the UI_Elem, its siblings and its children into the scene.
+///
+/// Clipped to the bounds of uie, the elements outside their clip aren't recorded.
+/// The serial Tick callbacks may change z (see UIElem_SetZ), but mustn't add, remove
+/// or delete elements, the tree is being walked; post those to the window's CommandQueue.
+void UIElem_Draw(UIElem* uie, Scene* scene);
 
 
 
@@ -137,15 +365,47 @@ void UIElem_AddCallback(UIElem *root, char* name, EventType evt, UIElem_EventCal
 void UIElem_RemoveCallback(UIElem* root, char* name, EventType evt, UIElem_EventCallback callback);
 /// \brief Frees the callback linked lists.
 void UIElem_RemoveCallbacks(UIElem* uie);
+/// \brief Releases a reference to a shared callback set, eg. the one kept by a History version.
+void UIElem_ReleaseCallbacks(UIElemCallbacks* cbs);
 /// \brief Fires the event.
 void UIElem_TriggerEvent(UIElem* uie, EventType evt);
 
 /* Event triggers */
 
-/// \brief Tells whether the mouse is "inside" the UI_Elem.
-bool UIElem_MouseInside(UIElem* uie);
-/// \brief Should be called on an SDL
-void Event_LMBUp(void);
+/// \brief Initializes the empty texture cache and hover state of a window.
+void UIContext_Init(UIContext* ctx, struct RGWindow* window);
+/// \brief Waits for the loader threads and frees the hover path, after the tree and so the textures are freed.
+void UIContext_Free(UIContext* ctx);
+/// \brief Sets the most memory the textures of the window keep after a frame, 0 for no limit.
+void UIContext_SetTextureBudget(UIContext* ctx, Sint64 bytes);
+/// \brief Uploads the textures reloaded by the loader thread, called at the start of the frame.
+void UIContext_FinishLoads(UIContext* ctx);
+/// \brief Evicts the least recently drawn textures which aren't on screen until the budget is kept, called after drawing.
+void UIContext_Evict(UIContext* ctx);
+
+/// \brief Tells whether the mouse is "inside" the root, updating the hover state of ctx.
+///
+/// The new hover path is compared with the previous one while descending,
+/// MouseLeave goes to the elements left (deepest first) up to the lowest common ancestor,
+/// then MouseEnter to the elements entered below it (topmost first).
+bool UIElem_MouseInside(UIContext* ctx, UIElem* root);
+/// \brief Turns a mouse event of the window into UIEvents and dispatches them.
+///
+/// Every mouse and window event of the window should be passed (see RGUI_WindowOf),
+/// they set the pointer state of ctx which the hit testing uses.
+/// The hovered element is the target. A left press gives LMBDown and a release
+/// over the same element gives LMBUp. The wheel gives Scroll.
+/// While an element has the pointer capture it's the target of every event:
+/// moving with the left button held gives Drag, and the release gives LMBUp
+/// to it and Drop to the hovered element. A callback can dispatch another event,
+/// and delete any element, the deleted ones don't get the rest of the event.
+void UIElem_Dispatch(UIContext* ctx, const SDL_Event* event);
+/// \brief The event being dispatched on this thread, NULL outside UIElem_Dispatch.
+UIEvent* UIEvent_Current(void);
+/// \brief The elements after the current one on the propagation path don't get the event.
+void UIEvent_StopPropagation(void);
+/// \brief The current element gets the pointer events until the left button is released.
+void UIEvent_CapturePointer(void);
 
 //RGUI: init
 //Builders
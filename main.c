@@ -1,29 +1,59 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include <SDL.h>
-#include <debugmalloc.h>
-#include <debugmalloc-impl.h>
 
+#include "Alloc.h"
 #include "Error.h"
 #include "UIElem.h"
 #include "RGUI.h"
-
-Uint32 _Mouse_X, _Mouse_Y;
-Uint32 _Mouse_Btn;
+#include "CustomUIElems.h"
+#include "Trace.h"
+#include "Replay.h"
+#include "TickPool.h"
 
 bool in_progress = true;
 
-Uint32 timer_func(Uint32 dt, void* param) {
-	SDL_Event ev;
-	ev.type = SDL_USEREVENT;
-	SDL_PushEvent(&ev);
-	return dt;
-}
+/// \brief The ms between the frames of the animations.
+#define FRAME_INTERVAL 15
+
+/// \brief Only wakes the event loop, the frame is rendered after it.
+void Frame_Timer(UIElem* root) { (void)root; }
 
 void Init_UI(UIElem*);
+void FloatElem(UIElem*);
+void Exit(UIElem*);
+
+/// \brief The same dispatch path for live and replayed events.
+void Dispatch_Event(SDL_Event* event) {
+	if (event->type == SDL_QUIT) {
+		in_progress = false;
+		return;
+	}
+	// Every window gets only its own events, so it hit-tests with its own pointer
+	RGWindow* target = RGUI_WindowOf(event);
+	if (target != NULL) UIElem_Dispatch(&target->ctx, event);
+}
 
+/// \brief Usage: [--watch] [--progressive] [--render-thread] [--parallel-tick] [--texture-budget MB] [--record file] [--replay file [--max-speed] [--headless]]
 int main(int argc, char* args[]) {
+	char *record_file = NULL, *replay_file = NULL;
+	Sint64 texture_budget = 0;
+	bool max_speed = false, headless = false, watch = false, render_thread = false, parallel_tick = false, progressive = false;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(args[i], "--record") == 0 && i + 1 < argc) record_file = args[++i];
+		else if (strcmp(args[i], "--replay") == 0 && i + 1 < argc) replay_file = args[++i];
+		else if (strcmp(args[i], "--max-speed") == 0) max_speed = true;
+		else if (strcmp(args[i], "--headless") == 0) headless = true;
+		else if (strcmp(args[i], "--watch") == 0) watch = true;
+		else if (strcmp(args[i], "--progressive") == 0) progressive = true;
+		else if (strcmp(args[i], "--render-thread") == 0) render_thread = true;
+		else if (strcmp(args[i], "--parallel-tick") == 0) parallel_tick = true;
+		else if (strcmp(args[i], "--texture-budget") == 0 && i + 1 < argc) texture_budget = (Sint64)SDL_atoi(args[++i]) << 20;
+	}
+	if (headless) SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
 	//Initialize SDL
 	if (SDL_Init(SDL_INIT_VIDEO) < 0) {
 		SDL_Log("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
@@ -31,70 +61,109 @@ int main(int argc, char* args[]) {
 	}
 
 	//Create window
-	RGWindow* window = RGUI_InitWindow("nhf.rgml");
-	Init_UI(window->ui_root);
+	CustomUIElems_Register();
+	RGUI_RegisterHandler("FloatElem", FloatElem);
+	RGUI_RegisterHandler("Exit", Exit);
+	RGWindow* window;
+	if (progressive) {
+		// The elements of the file are looked up by Init_UI, so it waits for the end of the parsing
+		window = RGUI_InitWindowProgressive("nhf.rgml");
+		window->loaded = Init_UI;
+	} else {
+		window = RGUI_InitWindow("nhf.rgml");
+		Init_UI(window->ui_root);
+	}
+	if (render_thread) RGUI_StartRenderThread(window);
+	if (parallel_tick) window->tick_pool = TickPool_Create(SDL_GetCPUCount());
+	UIContext_SetTextureBudget(&window->ctx, texture_budget);
 
-	SDL_TimerID tmr = SDL_AddTimer(15, timer_func, NULL);
+	if (record_file != NULL && !Replay_StartRecording(record_file)) exit(FILE_READ_ERROR);
+	if (replay_file != NULL && !Replay_Open(replay_file, SDL_GetWindowID(window->window))) exit(FILE_READ_ERROR);
+
+	// The timer events of a replay come from the recording
+	if (replay_file == NULL) Timer_Start(window->ui_root, FRAME_INTERVAL, FRAME_INTERVAL, Frame_Timer);
 	SDL_Event event;
 
 	while (in_progress) {
-		_Mouse_Btn = SDL_GetMouseState(&_Mouse_X, &_Mouse_Y);
-		SDL_WaitEvent(&event);
-
-		switch (event.type) {
-		case SDL_QUIT:
-			in_progress = false;
-			break;
-		case SDL_MOUSEBUTTONUP:
-			Event_LMBUp();
-			break;
+		if (replay_file != NULL) {
+			// Only a real quit is taken from the queue, the rest comes from the recording
+			SDL_PumpEvents();
+			if (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_QUIT, SDL_QUIT) > 0) break;
+			SDL_FlushEvents(SDL_FIRSTEVENT, SDL_LASTEVENT);
+			if (!Replay_Next(&event, max_speed)) break;
+		} else {
+			// Sleeps until the next deadline of the timers (not while there are tasks), waking up is a timer event
+			Sint32 timeout = window->tasks.count > 0 ? 0 : TimerWheel_Timeout(&window->timers, SDL_GetTicks());
+			if (!SDL_WaitEventTimeout(&event, timeout)) {
+				SDL_zero(event);
+				event.type = SDL_USEREVENT;
+				event.common.timestamp = SDL_GetTicks();
+			}
 		}
+		Uint64 frame_start = SDL_GetPerformanceCounter();
+		Latency_Input(&event);
+
+		Dispatch_Event(&event);
+		Replay_Record(&event, &window->ctx);
+		if (watch) RGUI_CheckReload(window);
 
-		SDL_RenderClear(window->renderer);
 		RGUI_Render(window);
-		SDL_RenderPresent(window->renderer);
+		RGUI_Present(window);
+
+		if (replay_file != NULL) Replay_FrameTime(SDL_GetPerformanceCounter() - frame_start);
+	}
+
+	if (replay_file != NULL) {
+		Replay_Report(stdout);
+		Replay_Close();
 	}
+	Replay_StopRecording();
 
 	// Free resources and close SDL
-	SDL_RemoveTimer(tmr);
 	RGUI_Free();
 	SDL_Quit();
 	
 	// Ouput debug info
+	Latency_Export("latency.log");
+#ifdef RGUI_TRACE
+	Trace_Flush("trace.json");
+#endif
+	Trace_Free();
+#ifdef RGUI_DEBUGMALLOC
 	remove("debugmalloc.log");
 	debugmalloc_log_file("debugmalloc.log");
 	debugmalloc_dump();
+#endif
 
 	return 0;
 }
 
-void InvertColor(UIElem* uie) {
-	uie->color = uie->color ^ 0xffffff00;
-}
-
 #include <math.h>
 void FloatElem(UIElem* uie) {
-	uie->rel_position.Y = 270 + 50*sin(SDL_GetTicks() / 600.0);
-	UIElem_Update(uie);
+	Vec2 position = uie->rel_position;
+	position.Y = 270 + 50*sin(SDL_GetTicks() / 600.0);
+	TickPool_Move(uie, position);
 }
 
 void Exit(UIElem* uie) {
 	in_progress = false;
 }
 
-void Init_UI(UIElem *window) {
-
-	UIElem_AddCallback(window, "button1", MouseEnter, InvertColor);
-	UIElem_AddCallback(window, "button1", MouseLeave, InvertColor);
-	UIElem_AddCallback(window, "button1", LMBUp, Exit);
-	UIElem_AddCallback(window, "button1", Tick, FloatElem);
+void FillRow(UIElem* row, size_t index, void* user) {
+	(void)user;
+	Uint8 shade = index % 2 ? 0x40 : 0x60;
+	row->color = (Uint32)(index * 7 % 256) << 24 | shade << 16 | shade << 8 | 0xff;
+}
 
-	UIElem_AddCallback(window, "button2", MouseEnter, InvertColor);
-	UIElem_AddCallback(window, "button2", MouseLeave, InvertColor);
-	UIElem_AddCallback(window, "button3", MouseEnter, InvertColor);
-	UIElem_AddCallback(window, "button3", MouseLeave, InvertColor);
-	UIElem_AddCallback(window, "button4", MouseEnter, InvertColor);
-	UIElem_AddCallback(window, "button4", MouseLeave, InvertColor);
+void Init_UI(UIElem *window) {
 
+	// The callbacks of the buttons are bound in the .rgml
+	UIElem_AddChild(window, ScrollList_Init(
+		(Vec2){ 400, 110 }, (Vec2){ 480, 500 }, 0x202020ff, "list",
+		40, 1000000, FillRow, NULL
+	));
+	// FloatElem only moves its own element, so it can run on the tick pool
+	UIElem* button = UIElem_FindElem("button1", window);
+	if (button != NULL) TickPool_SetParallel(button, true);
 }
 